@@ -1,5 +1,6 @@
 #include "geofun.hpp"
 #include <stdio.h>
+#include <cmath>
 
 //#include <iostream>
 //using namespace std;
@@ -10,80 +11,235 @@ char IndexError::msg[64];
 
 static WGS84 wgs84;
 static Sphere sphere;
+static GRS80 grs80;
+static International1924 international1924;
 
 
-static EarthModel* earth_model = &wgs84;
-AngleMode angle_mode = am_radians;
+static thread_local EarthModel* earth_model = &wgs84;
+thread_local AngleMode angle_mode = am_radians;
+static thread_local double vincenty_tolerance = default_vincenty_tolerance;
+static thread_local MathPrecision math_precision = mp_exact;
 
-void set_earth_model(const std::string& model_name)
+static EarthModel* find_earth_model(const std::string& model_name)
 {
   if (model_name == "wgs84") {
-    earth_model = &wgs84;
+    return &wgs84;
   }
   else if (model_name == "spherical") {
-    earth_model = &sphere;
+    return &sphere;
   }
   else if (model_name == "sphere") {
-    earth_model = &sphere;
+    return &sphere;
+  }
+  else if (model_name == "grs80") {
+    return &grs80;
+  }
+  else if (model_name == "international1924") {
+    return &international1924;
+  }
+  else if (model_name == "wgs84_table") {
+    // Built on first use
+    static TableEarthModel wgs84_table(wgs84_ellipsoid);
+    return &wgs84_table;
   }
   else {
     throw EarthModelError();
   }
 }
 
-void set_angle_mode(const std::string& mode_name)
+static AngleMode find_angle_mode(const std::string& mode_name)
 {
   if (mode_name == "radians") {
-    angle_mode = am_radians;
+    return am_radians;
   }
   else if (mode_name == "degrees") {
-    angle_mode = am_degrees;
+    return am_degrees;
   }
   else {
     throw AngleModeError();
   }
 }
 
+void set_earth_model(const std::string& model_name)
+{
+  earth_model = find_earth_model(model_name);
+}
+
+void set_earth_model(EarthModel& model)
+{
+  earth_model = &model;
+}
+
+void set_angle_mode(const std::string& mode_name)
+{
+  angle_mode = find_angle_mode(mode_name);
+}
+
 EarthModel* get_earth_model()
 {
   return earth_model;
 }
 
+double get_vincenty_tolerance()
+{
+  return vincenty_tolerance;
+}
+
+void set_vincenty_tolerance(const double tolerance)
+{
+  vincenty_tolerance = tolerance;
+}
+
+MathPrecision get_math_precision()
+{
+  return math_precision;
+}
+
+void set_math_precision(const MathPrecision precision)
+{
+  math_precision = precision;
+}
+
+Context::Context(const std::string& angle_mode_name, const std::string& earth_model_name):
+  angle_mode(find_angle_mode(angle_mode_name)),
+  earth_model(find_earth_model(earth_model_name)),
+  vincenty_tolerance(default_vincenty_tolerance),
+  math_precision(mp_exact)
+{
+}
+
+Context get_context()
+{
+  Context context;
+  context.angle_mode = angle_mode;
+  context.earth_model = earth_model;
+  context.vincenty_tolerance = vincenty_tolerance;
+  context.math_precision = math_precision;
+  return context;
+}
+
+void set_context(const Context& context)
+{
+  angle_mode = context.angle_mode;
+  earth_model = context.earth_model ? context.earth_model : &wgs84;
+  vincenty_tolerance = context.vincenty_tolerance;
+  math_precision = context.math_precision;
+}
+
+void rhumb_direct(const double lat1, const double lon1,
+    const double azimuth, const double range, double* lat2, double* lon2)
+{
+  get_earth_model()->rhumb_direct(lat1, lon1, azimuth, range, lat2, lon2);
+}
+
+void rhumb_inverse(const double lat1, const double lon1,
+    const double lat2, const double lon2, double* azimuth, double* range)
+{
+  get_earth_model()->rhumb_inverse(lat1, lon1, lat2, lon2, azimuth, range);
+}
+
+bool rhumb_intersection(const double lat1, const double lon1,
+    const double lat2, const double lon2,
+    const double lat3, const double lon3,
+    const double lat4, const double lon4,
+    double* lat, double* lon)
+{
+  const Ellipsoid& e = get_earth_model()->get_ellipsoid();
+  const double y1 = e.isometric_latitude(lat1);
+  const double y3 = e.isometric_latitude(lat3);
+  const double dx1 = angle_diff(lon2, lon1);
+  const double dy1 = e.isometric_latitude(lat2) - y1;
+  const double dx2 = angle_diff(lon4, lon3);
+  const double dy2 = e.isometric_latitude(lat4) - y3;
+  // Longitudes relative to position 1, with the second line moved by whole
+  // turns to have its middle within half a turn of the middle of the first
+  double x3 = angle_diff(lon3, lon1);
+  double mid = x3 + 0.5 * (dx2 - dx1);
+  x3 += angle_pipi(mid) - mid;
+
+  const double det = dx1 * dy2 - dy1 * dx2;
+  if (det == 0) {
+    return false;
+  }
+  const double wx = x3;
+  const double wy = y3 - y1;
+  const double s = (wx * dy2 - wy * dx2) / det;
+  const double t = (wx * dy1 - wy * dx1) / det;
+  *lon = angle_pipi(lon1 + s * dx1);
+  *lat = e.geodetic_latitude(y1 + s * dy1);
+  return s >= 0 and s <= 1 and t >= 0 and t <= 1;
+}
+
+HermiteTable::HermiteTable(const double x0, const double x1,
+    const std::vector<double>& values, const std::vector<double>& slopes):
+  _x0(x0),
+  _scale((values.size() - 1) / (x1 - x0)),
+  _last(static_cast<int>(values.size()) - 2),
+  _nodes(2 * values.size())
+{
+  for (size_t i = 0; i < values.size(); ++i) {
+    _nodes[2 * i] = values[i];
+    _nodes[2 * i + 1] = slopes[i] / _scale;
+  }
+}
+
+// Intervals of the tables of TableEarthModel. The meridian arc and its
+// inverse are smooth to the poles; the isometric latitude steepens towards
+// its limit and needs a finer grid to keep its slope within 1E-8.
+static const int table_arc_intervals = 1024;
+static const int table_isometric_intervals = 4096;
+
+TableEarthModel::TableEarthModel(const Ellipsoid& ellipsoid): _ellipsoid(ellipsoid)
+{
+  const Ellipsoid& e = _ellipsoid;
+  const double quarter = e.quarter_meridian();
+  std::vector<double> values(table_arc_intervals + 1);
+  std::vector<double> slopes(table_arc_intervals + 1);
+  for (int i = 0; i <= table_arc_intervals; ++i) {
+    double lat = -half_pi + pi * i / table_arc_intervals;
+    double w = 1 - e.e2 * sqr(sin(lat));
+    values[i] = e.meridian_arc(lat);
+    slopes[i] = e.a * (1 - e.e2) / (w * sqrt(w));
+  }
+  _arc = HermiteTable(-half_pi, half_pi, values, slopes);
+  for (int i = 0; i <= table_arc_intervals; ++i) {
+    double lat = e.meridian_latitude(-quarter + 2 * quarter * i / table_arc_intervals);
+    double w = 1 - e.e2 * sqr(sin(lat));
+    values[i] = lat;
+    slopes[i] = w * sqrt(w) / (e.a * (1 - e.e2));
+  }
+  _latitude = HermiteTable(-quarter, quarter, values, slopes);
+
+  values.resize(table_isometric_intervals + 1);
+  slopes.resize(table_isometric_intervals + 1);
+  for (int i = 0; i <= table_isometric_intervals; ++i) {
+    double lat = table_isometric_limit * (2.0 * i / table_isometric_intervals - 1);
+    double w = 1 - e.e2 * sqr(sin(lat));
+    values[i] = e.isometric_latitude(lat);
+    slopes[i] = (1 - e.e2) / (w * cos(lat));
+  }
+  _isometric = HermiteTable(-table_isometric_limit, table_isometric_limit, values, slopes);
+}
+
+Coord TableEarthModel::cartesian_deltas(const double lat)
+{
+  double angle = lat;
+  angle_pi2pi2(&angle);
+  return Coord(_arc.slope(angle), parallel_radius(angle));
+}
+
 Position& Position::operator+=(const Vector& vector)
 {
-  Coord deltas1 = cartesian_deltas();
-  Coord cart = vector.cartesian();
-  Position mid_pos;
-  mid_pos._set_latlon(
-      _lat + 0.5 * cart.get_x() / deltas1.get_x(),
-      _lon + 0.5 * cart.get_y() / deltas1.get_y());
-  Coord deltas2 = mid_pos.cartesian_deltas();
-  mid_pos._set_latlon(
-      _lat + cart.get_x() / (deltas1.get_x() + deltas2.get_x()),
-      _lon + cart.get_y() / (deltas1.get_y() + deltas2.get_y()));
-  deltas2 = mid_pos.cartesian_deltas();
-  Position end_pos;
-  end_pos._set_latlon(
-      _lat + cart.get_x() / deltas2.get_x(),
-      _lon + cart.get_y() / deltas2.get_y());
-  Coord deltas3 = end_pos.cartesian_deltas();
-  Coord inv_deltas = (1.0 / 6) * (1 / deltas1 + 4 / deltas2 + 1 / deltas3);
-  _set_latlon(_lat + cart.get_x() * inv_deltas.get_x(), _lon + cart.get_y() * inv_deltas.get_y());
+  PositionValue p = value();
+  p += vector.value();
+  _lat = p.lat;
+  _lon = p.lon;
   return *this;
 }
 
 Vector Position::operator-(const Position& position) const
 {
-  double dlat = angle_diff(this->_lat, position._lat);
-  double dlon = angle_diff(this->_lon, position._lon);
-  Coord deltas1 = position.cartesian_deltas();
-  Coord deltas3 = this->cartesian_deltas();
-  Position mid_lat;
-  mid_lat.set_lat(from_rads(0.5 * (this->_lat + position._lat)));
-  Coord deltas2 = mid_lat.cartesian_deltas();
-  Coord deltas = 6.0 / (1.0 / deltas1 + 4.0 / deltas2 + 1.0 / deltas3);
-  Coord cart = Coord(dlat  * deltas.get_x(), dlon  * deltas.get_y());
-  return Vector(cart);
+  return Vector(value() - position.value());
 }
 
 Vector Position::operator-(const Simple& position) const
@@ -119,34 +275,150 @@ Position Line::intersection(const Line& line) const {
   if (!intersects(line)) {
     return Position(from_rads(-pi), 0);
   }
-  
-  Position p(_p1);
-  double l;
-  do {
-    Vector v = line._p1 - p;
-    double a1 = fabs(angle_diff(line._v._a, _v._a));
-    double a2 = fabs(angle_diff(_v._a, v._a));
-    double a3 = pi - a2 - a1;
-    double d = sin(a3) * v._r;
-    l = d / sin(a1);
-    double f = l / _v._r;
-    p += _v * f;
-  } while (fabs(l) > 10);
+  PositionValue p1 = _p1.value();
+  PositionValue p2 = _p2.value();
+  PositionValue p3 = line._p1.value();
+  PositionValue p4 = line._p2.value();
+  PositionValue x = p1;
+  rhumb_intersection(p1.lat, p1.lon, p2.lat, p2.lon, p3.lat, p3.lon, p4.lat, p4.lon,
+      &x.lat, &x.lon);
+  return Position(x);
+}
+
+// Longitude difference reached by the geodesic leaving reduced latitude u1
+// (not north of the equator) at azimuth a1, where it first passes reduced
+// latitude u2 heading north. Also yields the arc and terms for the distance.
+struct FallbackGeodesic {
+  FallbackGeodesic(const double sinu1, const double cosu1,
+      const double sinu2, const double cosu2, const double a1, const double f) {
+    const double sina1 = sin(a1);
+    const double cosa1 = cos(a1);
+    sina = sina1 * cosu1;
+    sqcosa = (1 - sina) * (1 + sina);
+    // Given |u1| >= |u2| the root is real; cos(a2) is taken positive
+    cosa2cosu2 = sqrt(std::max(0.0, sqr(cosa1 * cosu1) + (cosu2 - cosu1) * (cosu2 + cosu1)));
+    double sig1 = atan2(sinu1, cosa1 * cosu1);
+    double sig2 = atan2(sinu2, cosa2cosu2);
+    double om1 = atan2(sina * sin(sig1), cos(sig1));
+    double om2 = atan2(sina * sin(sig2), cos(sig2));
+    // Point 1 lies south of the equator, so on the descending half
+    if (sig1 > 0) {
+      sig1 -= two_pi;
+    }
+    if (om1 > 0) {
+      om1 -= two_pi;
+    }
+    sig = sig2 - sig1;
+    sins = sin(sig);
+    coss = cos(sig);
+    cos2sm = cos(sig1 + sig2);
+    double c = f / 16 * sqcosa * (4 + f * (4 - 3 * sqcosa));
+    dl = om2 - om1 - (1 - c) * f * sina
+        * (sig + c * sins * (cos2sm + c * coss * (2 * sqr(cos2sm) - 1)));
+  }
+  double sina;
+  double sqcosa;
+  double cosa2cosu2;
+  double sig;
+  double sins;
+  double coss;
+  double cos2sm;
+  double dl;
+};
+
+// Bisect the azimuth at position 1 of the reduced problem
+static void bisect_fallback(const double sinu1, const double cosu1,
+    const double sinu2, const double cosu2, const double dl, const Ellipsoid& e,
+    double* distance, double* a1, double* a2)
+{
+  double lo = 0;
+  double hi = pi;
+  for (int i = 0; i < 64 and hi - lo > 1E-15; ++i) {
+    double mid = 0.5 * (lo + hi);
+    if (FallbackGeodesic(sinu1, cosu1, sinu2, cosu2, mid, e.f).dl < dl) {
+      lo = mid;
+    }
+    else {
+      hi = mid;
+    }
+  }
+  *a1 = 0.5 * (lo + hi);
+  FallbackGeodesic g(sinu1, cosu1, sinu2, cosu2, *a1, e.f);
+  double squ = g.sqcosa * e.ep2;
+  double sqrtsqup1 = sqrt(1 + squ);
+  double k1 = (sqrtsqup1 - 1) / (sqrtsqup1 + 1);
+  double aa = (1 + 0.25 * sqr(k1)) / (1 - k1);
+  double bb = k1 * (1 - (3.0 / 8) * sqr(k1));
+  double sqcos2sm = sqr(g.cos2sm);
+  double dsig = bb * g.sins * (g.cos2sm + 0.25 * bb * (g.coss * (2 * sqcos2sm - 1) -
+      (1.0 / 6) * bb * g.cos2sm * (-3 + 4 * sqr(g.sins)) * (-3 + 4 * sqcos2sm)));
+  *distance = e.b * aa * (g.sig - dsig);
+  *a2 = atan2(g.sina, g.cosa2cosu2);
+}
+
+void vincenty_inverse_fallback(double sinu1, double cosu1,
+    double sinu2, double cosu2, const double dlinit, const Ellipsoid& e,
+    double* distance, double* azimuth1, double* azimuth2)
+{
+  // Reduce to position 1 not north of the equator and at least as far from
+  // it as position 2, and position 2 east of position 1. The longitude
+  // difference then grows monotonically from 0 to pi with the azimuth at
+  // position 1 going from 0 to pi.
+  double dl = angle_pipi(dlinit);
+  if (dl == 0 and sinu1 == sinu2 and cosu1 == cosu2) {
+    *distance = 0;
+    *azimuth1 = 0;
+    *azimuth2 = 0;
+    return;
+  }
+  const bool swap = fabs(sinu1) < fabs(sinu2);
+  if (swap) {
+    std::swap(sinu1, sinu2);
+    std::swap(cosu1, cosu2);
+    dl = -dl;
+  }
+  const double lonsign = dl < 0 ? -1 : 1;
+  dl *= lonsign;
+  const double latsign = sinu1 > 0 ? -1 : 1;
+  sinu1 *= latsign;
+  sinu2 *= latsign;
+
+  double a1, a2;
+  if (sinu1 == 0 and dl <= (1 - e.f) * pi) {
+    // Both on the equator and close enough for the equator to be shortest
+    *distance = e.a * dl;
+    a1 = pi / 2;
+    a2 = pi / 2;
+  }
+  else {
+    bisect_fallback(sinu1, cosu1, sinu2, cosu2, dl, e, distance, &a1, &a2);
+  }
 
-  return p;
+  // Undo the reductions
+  if (latsign < 0) {
+    a1 = pi - a1;
+    a2 = pi - a2;
+  }
+  if (swap) {
+    double a = a1;
+    a1 = a2 + pi;
+    a2 = a + pi;
+  }
+  *azimuth1 = angle_2pi(lonsign * a1);
+  *azimuth2 = angle_2pi(lonsign * a2);
 }
 
-void Arc::vincenty_inverse(const Position& p1, const Position& p2, Vector* v, Vector* r, double* alpha)
+template <class Math>
+VincentyStatus Arc::solve_inverse(const Position& p1, const Position& p2,
+    Vector* v, Vector* r, double* alpha, const Ellipsoid& e)
 {
   // Formula obtained from http://en.wikipedia.org/wiki/Vincenty%27s_formulae
-  double u1 = reduced_latitude(p1._lat);
-  double u2 = reduced_latitude(p2._lat);
+  const double f = e.f;
   double dlinit = p2._lon - p1._lon;
 
-  double sinu1 = sin(u1);
-  double cosu1 = cos(u1);
-  double sinu2 = sin(u2);
-  double cosu2 = cos(u2);
+  double sinu1, cosu1, sinu2, cosu2;
+  e.reduced_sincos(p1._lat, &sinu1, &cosu1);
+  e.reduced_sincos(p2._lat, &sinu2, &cosu2);
   double sinu1sinu2 = sinu1 * sinu2;
   double cosu1cosu2 = cosu1 * cosu2;
   double cosu1sinu2 = cosu1 * sinu2;
@@ -160,14 +432,15 @@ void Arc::vincenty_inverse(const Position& p1, const Position& p2, Vector* v, Ve
   double cos2sm, sqcos2sm, coss2sqcos2smm1;
   
   double dlprev;
+  const double tolerance = get_vincenty_tolerance();
+  int iterations = 0;
 
   do {
     dlprev = dl;
-    cosdl = cos(dl);
-    sindl = sin(dl);
+    Math::sin_cos(dl, &sindl, &cosdl);
     sins = sqrt(sqr(cosu2 * sindl) + sqr(cosu1sinu2 - sinu1cosu2 * cosdl));
     coss = sinu1sinu2 + cosu1cosu2 * cosdl;
-    sig = atan2(sins, coss);
+    sig = Math::atan2(sins, coss);
     sina = cosu1cosu2 * sindl / sins;
     sqcosa = 1 - sqr(sina);
     cos2sm = coss - 2 * sinu1sinu2 / sqcosa;
@@ -175,9 +448,21 @@ void Arc::vincenty_inverse(const Position& p1, const Position& p2, Vector* v, Ve
     sqcos2sm = sqr(cos2sm);
     coss2sqcos2smm1 = coss * (2 * sqcos2sm - 1);
     dl = dlinit + (1 - c) * f * sina * (sig + c * sins * (cos2sm + c * coss2sqcos2smm1));
-  } while (fabs(dl -  dlprev) > 1E-7);
+  } while (fabs(dl -  dlprev) > tolerance and ++iterations < vincenty_max_iterations);
 
-  double squ = sqcosa * (sqa - sqb) / sqb;
+  // Coincident and exactly antipodal points yield NaN
+  if (iterations == vincenty_max_iterations or std::isnan(sina) or std::isnan(cos2sm)) {
+    double distance, a1, a2;
+    vincenty_inverse_fallback(sinu1, cosu1, sinu2, cosu2, dlinit, e, &distance, &a1, &a2);
+    v->_set_r(distance);
+    r->_set_r(distance);
+    v->_set_a(a1);
+    r->_set_a(pi - a2);
+    *alpha = asin(sin(a1) * cosu1);
+    return vs_fallback;
+  }
+
+  double squ = sqcosa * e.ep2;
   /* Original ->
   double aa = 1 + squ / 16384 * (4096 + squ * (-768 + squ * (320 - 175 * squ)));
   double bb = squ / 1024 * (256 + squ * (-128 + squ * (74 - 47 * squ)));
@@ -190,81 +475,325 @@ void Arc::vincenty_inverse(const Position& p1, const Position& p2, Vector* v, Ve
     
   double dsig = bb * sins * (cos2sm + 0.25 * bb * (coss2sqcos2smm1 - 
       (1.0 / 6) * bb * cos2sm * (-3 + 4 * sqr(sins)) * (-3 + 4 * sqcos2sm)));
-  v->_set_r(b * aa * (sig - dsig));
+  v->_set_r(e.b * aa * (sig - dsig));
   r->_set_r(v->_r);
-  v->_set_a(atan2(cosu2 * sindl, cosu1sinu2 - sinu1cosu2 * cosdl));
-  r->_set_a(pi - atan2(cosu1 * sindl, -sinu1cosu2 + cosu1sinu2 * cosdl));
+  v->_set_a(Math::atan2(cosu2 * sindl, cosu1sinu2 - sinu1cosu2 * cosdl));
+  r->_set_a(pi - Math::atan2(cosu1 * sindl, -sinu1cosu2 + cosu1sinu2 * cosdl));
   *alpha = asin(sina);
+  return vs_converged;
+}
+
+VincentyStatus Arc::vincenty_inverse(const Position& p1, const Position& p2,
+    Vector* v, Vector* r, double* alpha, const Ellipsoid& e)
+{
+  if (get_math_precision() == mp_fast) {
+    return solve_inverse<FastMath>(p1, p2, v, r, alpha, e);
+  }
+  return solve_inverse<ExactMath>(p1, p2, v, r, alpha, e);
 }
 
-void Arc::vincenty_direct(const Position& p1, const Vector& v, Position* p2, Vector* r, double* alpha)
+VincentyStatus vincenty_inverse(const PositionValue& p1, const PositionValue& p2,
+    const Ellipsoid& ellipsoid, double* distance, double* azimuth, double* reverse_azimuth)
 {
-  double u1 = reduced_latitude(p1._lat);
-  double cosa1 = cos(v._a);
-  double sina1 = sin(v._a);
-  double sig1 = atan2(tan(u1), cosa1);
-  double cosu1 = cos(u1);
-  double sinu1 = sin(u1);
-  double sina = cosu1 * sin(v._a);
+  Vector v, r;
+  double alpha;
+  const VincentyStatus status = Arc::vincenty_inverse(Position(p1), Position(p2),
+      &v, &r, &alpha, ellipsoid);
+  *distance = v.value().r;
+  *azimuth = v.value().a;
+  if (reverse_azimuth) {
+    *reverse_azimuth = r.value().a;
+  }
+  return status;
+}
+
+template <class Math>
+VincentyStatus Arc::solve_direct(const Position& p1, const Vector& v,
+    Position* p2, Vector* r, double* alpha, const Ellipsoid& e)
+{
+  const double f = e.f;
+  double sinu1, cosu1, sina1, cosa1;
+  e.reduced_sincos(p1._lat, &sinu1, &cosu1);
+  Math::sin_cos(v._a, &sina1, &cosa1);
+  double sig1 = Math::atan2(sinu1 / cosu1, cosa1);
+  double sina = cosu1 * sina1;
   double sqcosa = (1 - sina) * (1 + sina);
-  double squ = sqcosa * (sqa - sqb) / sqb;
+  double squ = sqcosa * e.ep2;
   double sqrtsqup1 = sqrt(1 + squ);
   double k1 = (sqrtsqup1 - 1) / (sqrtsqup1 + 1);
   double aa = (1 + 0.25 * sqr(k1)) / (1 - k1);
   double bb = k1 * (1 - (3.0 / 8) * sqr(k1));
-  double siginit = v._r / (b * aa);
+  double siginit = v._r / (e.b * aa);
   double sig = siginit;
 
   double sins, coss;
   double tsm, cos2sm, sqcos2sm, coss2sqcos2smm1;
  
   double sigprev;
+  const double tolerance = get_vincenty_tolerance();
+  int iterations = 0;
   do {
     sigprev = sig;
-    sins = sin(sig);
-    coss = cos(sig);
+    Math::sin_cos(sig, &sins, &coss);
     tsm = 2 * sig1 + sig;
-    cos2sm = cos(tsm);
+    cos2sm = Math::cos(tsm);
     sqcos2sm = sqr(cos2sm);
     coss2sqcos2smm1 = coss * (2 * sqcos2sm - 1);
     double dsig = bb * sins * (cos2sm + 0.25 * bb * (coss2sqcos2smm1 - 
         (1.0 / 6) * bb * cos2sm * (-3 + 4 * sqr(sins)) * (-3 + 4 * sqcos2sm)));
     sig = siginit + dsig;
-  } while (fabs(sig - sigprev) > 1E-7);
+  } while (fabs(sig - sigprev) > tolerance and ++iterations < vincenty_max_iterations);
 
-  double f2 = atan2(sinu1 * coss + cosu1 * sins * cosa1,
+  double f2 = Math::atan2(sinu1 * coss + cosu1 * sins * cosa1,
       (1 - f) * sqrt(sqr(sina) + sqr(sinu1 * sins - cosu1 * coss * cosa1)));
-  double dl = atan2(sins * sina1, cosu1 * coss - sinu1 * sins * cosa1);
+  double dl = Math::atan2(sins * sina1, cosu1 * coss - sinu1 * sins * cosa1);
   double c = f / 16 * sqcosa * (4 + f * (4 - 3 * sqcosa));
   double dlinit = dl 
       - (1 - c) * f * sina * (sig + c * sins * (cos2sm + c * coss2sqcos2smm1));
-  r->_set_a(pi - atan2(sina, -sinu1 * sins + cosu1 * coss * cosa1));
+  r->_set_a(pi - Math::atan2(sina, -sinu1 * sins + cosu1 * coss * cosa1));
   r->_set_r(v._r);
   p2->_set_lat(f2);
   p2->_set_lon(p1._lon + dlinit);
   *alpha = asin(sina);
+  return iterations < vincenty_max_iterations ? vs_converged : vs_max_iterations;
 }
 
-bool Arc::intersects(const Line& line) const
+VincentyStatus Arc::vincenty_direct(const Position& p1, const Vector& v,
+    Position* p2, Vector* r, double* alpha, const Ellipsoid& e)
+{
+  if (get_math_precision() == mp_fast) {
+    return solve_direct<FastMath>(p1, v, p2, r, alpha, e);
+  }
+  return solve_direct<ExactMath>(p1, v, p2, r, alpha, e);
+}
+
+void Arc::lat_bounds(double* min_lat, double* max_lat) const
+{
+  *min_lat = std::min(_p1._lat, _p2._lat);
+  *max_lat = std::max(_p1._lat, _p2._lat);
+  // Forward azimuth at the end is pi minus the reverse azimuth
+  const double cosa1 = cos(_v._a);
+  const double cosa2 = -cos(_r._a);
+  if ((cosa1 > 0 and cosa2 < 0) or (cosa1 < 0 and cosa2 > 0)) {
+    // The vertex has reduced latitude acos(|sin(alpha)|)
+    const double sina = fabs(sin(_alpha));
+    const double f = _ellipsoid.f;
+    const double vertex = atan2(sqrt((1 - sina) * (1 + sina)), (1 - f) * sina);
+    if (cosa1 > 0) {
+      *max_lat = vertex;
+    }
+    else {
+      *min_lat = -vertex;
+    }
+  }
+}
+
+// Bounding box as min_lat, max_lat, min_lon, max_lon in radians
+void Arc::box(double* box) const
+{
+  lat_bounds(&box[0], &box[1]);
+  box[2] = _v._a <= pi ? _p1._lon : _p2._lon;
+  box[3] = _v._a <= pi ? _p2._lon : _p1._lon;
+}
+
+static void line_box(const Line& line, double* box)
+{
+  PositionValue p1 = line.get_p1().value();
+  PositionValue p2 = line.get_p2().value();
+  bool eastward = line.get_v().value().a <= pi;
+  box[0] = std::min(p1.lat, p2.lat);
+  box[1] = std::max(p1.lat, p2.lat);
+  box[2] = eastward ? p1.lon : p2.lon;
+  box[3] = eastward ? p2.lon : p1.lon;
+}
+
+static bool boxes_overlap(const double* box1, const double* box2)
+{
+  if (box1[0] > box2[1] or box2[0] > box1[1]) {
+    return false;
+  }
+  double span1 = angle_2pi(box1[3] - box1[2]);
+  double span2 = angle_2pi(box2[3] - box2[2]);
+  return angle_2pi(box2[2] - box1[2]) <= span1 or angle_2pi(box1[2] - box2[2]) <= span2;
+}
+
+// Position and forward azimuth at distance s from the start of the arc
+void Arc::along(const double s, PositionValue* p, double* azimuth) const
+{
+  Position position;
+  Vector r;
+  double alpha;
+  VectorValue v = {_v._a, s};
+  vincenty_direct(_p1, Vector(v), &position, &r, &alpha, _ellipsoid);
+  *p = position.value();
+  *azimuth = pi - r._a;
+}
+
+static void unit_vector(const PositionValue& p, double* u)
+{
+  u[0] = cos(p.lat) * cos(p.lon);
+  u[1] = cos(p.lat) * sin(p.lon);
+  u[2] = sin(p.lat);
+}
+
+static void cross3(const double* u, const double* v, double* w)
+{
+  w[0] = u[1] * v[2] - u[2] * v[1];
+  w[1] = u[2] * v[0] - u[0] * v[2];
+  w[2] = u[0] * v[1] - u[1] * v[0];
+}
+
+static double dot3(const double* u, const double* v)
+{
+  return u[0] * v[0] + u[1] * v[1] + u[2] * v[2];
+}
+
+static double angle3(const double* u, const double* v)
 {
-  // TODO
+  double w[3];
+  cross3(u, v, w);
+  return atan2(sqrt(dot3(w, w)), dot3(u, v));
+}
+
+// Fractions along two segments at which their great circles cross on the
+// sphere, as an estimate for the solver below. Fails when the segments
+// are parallel or clearly don't meet.
+static bool spherical_crossing(const PositionValue& p1, const PositionValue& p2,
+    const PositionValue& q1, const PositionValue& q2, double* f1, double* f2)
+{
+  const double margin = 0.25;
+  double u1[3], u2[3], w1[3], w2[3], n1[3], n2[3], x[3];
+  unit_vector(p1, u1);
+  unit_vector(p2, u2);
+  unit_vector(q1, w1);
+  unit_vector(q2, w2);
+  cross3(u1, u2, n1);
+  cross3(w1, w2, n2);
+  cross3(n1, n2, x);
+  double norm = sqrt(dot3(x, x));
+  double a1 = angle3(u1, u2);
+  double a2 = angle3(w1, w2);
+  if (norm < 1E-12 or a1 == 0 or a2 == 0) {
+    return false;
+  }
+  // Of the two crossings, take the one nearest the first segment
+  double m[3] = {u1[0] + u2[0], u1[1] + u2[1], u1[2] + u2[2]};
+  double sign = dot3(x, m) < 0 ? -1 : 1;
+  for (int i = 0; i < 3; ++i) {
+    x[i] *= sign / norm;
+  }
+  double c[3];
+  cross3(u1, x, c);
+  *f1 = (dot3(c, n1) < 0 ? -1 : 1) * angle3(u1, x) / a1;
+  cross3(w1, x, c);
+  *f2 = (dot3(c, n2) < 0 ? -1 : 1) * angle3(w1, x) / a2;
+  return *f1 > -margin and *f1 < 1 + margin and *f2 > -margin and *f2 < 1 + margin;
+}
+
+// Newton iteration for the distances s and t at which two paths meet.
+// The paths are given as functions returning the position and forward
+// azimuth at a distance along them. The mismatch is measured in a local
+// north/east plane on ellipsoid e, which is exact in the limit.
+template <class Path1, class Path2>
+static bool path_intersection(const Ellipsoid& e, const Path1& path1, const double length1,
+    const Path2& path2, const double length2, double s, double t, Position* x)
+{
+  const double tolerance = 1E-4;
+  for (int i = 0; i < 50; ++i) {
+    PositionValue p1, p2;
+    double a1, a2;
+    path1(s, &p1, &a1);
+    path2(t, &p2, &a2);
+    CoordValue d = ellipsoid_deltas(e, 0.5 * (p1.lat + p2.lat));
+    double north = (p2.lat - p1.lat) * d.x;
+    double east = angle_pipi(p2.lon - p1.lon) * d.y;
+    double det = sin(a1 - a2);
+    if (fabs(det) < 1E-12) {
+      return false;
+    }
+    double ds = (cos(a2) * east - sin(a2) * north) / det;
+    double dt = (cos(a1) * east - sin(a1) * north) / det;
+    s += ds;
+    t += dt;
+    if (s < -length1 or s > 2 * length1 or t < -length2 or t > 2 * length2) {
+      return false;
+    }
+    if (fabs(ds) + fabs(dt) < tolerance) {
+      if (s < -tolerance or s > length1 + tolerance or t < -tolerance or t > length2 + tolerance) {
+        return false;
+      }
+      path1(s, &p1, &a1);
+      *x = Position(p1);
+      return true;
+    }
+  }
   return false;
 }
 
+bool Arc::find_intersection(const Line& line, Position* x) const
+{
+  double box1[4], box2[4];
+  box(box1);
+  line_box(line, box2);
+  double f1, f2;
+  PositionValue q1 = line.get_p1().value();
+  VectorValue v = line.get_v().value();
+  if (not boxes_overlap(box1, box2)
+      or not spherical_crossing(_p1.value(), _p2.value(), q1, line.get_p2().value(), &f1, &f2)) {
+    return false;
+  }
+  return path_intersection(_ellipsoid,
+      [this](const double s, PositionValue* p, double* a) { along(s, p, a); }, _v._r,
+      [&](const double t, PositionValue* p, double* a) {
+        rhumb_direct(q1.lat, q1.lon, v.a, t, &p->lat, &p->lon);
+        *a = v.a;
+      }, v.r, f1 * _v._r, f2 * v.r, x);
+}
+
+bool Arc::find_intersection(const Arc& arc, Position* x) const
+{
+  double box1[4], box2[4];
+  box(box1);
+  arc.box(box2);
+  double f1, f2;
+  if (not boxes_overlap(box1, box2)
+      or not spherical_crossing(_p1.value(), _p2.value(), arc._p1.value(), arc._p2.value(), &f1, &f2)) {
+    return false;
+  }
+  return path_intersection(_ellipsoid,
+      [this](const double s, PositionValue* p, double* a) { along(s, p, a); }, _v._r,
+      [&arc](const double t, PositionValue* p, double* a) { arc.along(t, p, a); }, arc._v._r,
+      f1 * _v._r, f2 * arc._v._r, x);
+}
+
+bool Arc::intersects(const Line& line) const
+{
+  Position x;
+  return find_intersection(line, &x);
+}
+
 Position Arc::intersection(const Line& line) const
 {
-  return Position(from_rads(pi), 0);
+  Position x;
+  if (not find_intersection(line, &x)) {
+    return Position(from_rads(pi), 0);
+  }
+  return x;
 }
 
 bool Arc::intersects(const Arc& arc) const
 {
-  // TODO
-  return false;
+  Position x;
+  return find_intersection(arc, &x);
 }
 
 Position Arc::intersection(const Arc& arc) const
 {
-  return Position(from_rads(-pi), 0);
+  Position x;
+  if (not find_intersection(arc, &x)) {
+    return Position(from_rads(-pi), 0);
+  }
+  return x;
 }
 
 }  // namespace geofun
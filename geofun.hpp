@@ -2,10 +2,14 @@
 #define __GEOFUN_HPP
 
 #include <math.h>
+#include <cmath>
 #include <algorithm>
 #include <cassert>
+#include <cfloat>
 #include <cstdio>
 #include <string>
+#include <type_traits>
+#include <vector>
 
 namespace geofun {
 
@@ -45,33 +49,232 @@ inline double sqr(const double x)
   return x * x;
 }
 
-inline double reduced_latitude(const double geodetic_latitude) 
+// Precision of the trigonometry in the Vincenty solvers. mp_fast uses the
+// polynomial approximations below, which are good to about 2E-9 rad.
+typedef enum {mp_exact, mp_fast} MathPrecision;
+
+// Sine and cosine of one angle. Side by side, compilers merge the two into
+// a single sincos call.
+inline void sin_cos(const double x, double* s, double* c)
 {
-  return atan2((1 - f) * sin(geodetic_latitude), cos(geodetic_latitude));
+  *s = sin(x);
+  *c = cos(x);
 }
 
-inline double angle_pipi(const double angle)
+// Polynomial sine and cosine within 2E-9. There are no calls and every
+// branch is a select, so loops over them vectorize when built with
+// -fno-trapping-math, which lets the compiler evaluate both sides.
+inline void fast_sin_cos(const double x, double* s, double* c)
 {
-  double result = angle;
-  while (result < -pi) {
-    result += two_pi;
+  // Reduce to [-pi/4, pi/4] around the nearest multiple k of pi/2, which is
+  // split in two parts to keep the reduction exact. Adding and subtracting
+  // 1.5 * 2^52 rounds to an integer, for |x| up to about 2^51, and keeps
+  // the quadrant q = k mod 4 in doubles, which vectorize where integers
+  // converted from doubles don't.
+  const double shifter = 6755399441055744.0;
+  const double k = (x * 0.63661977236758134 + shifter) - shifter;
+  const double q = k - 4 * ((k * 0.25 - 0.375 + shifter) - shifter);
+  const double t = (x - k * 1.5707963267341256) - k * 6.0771005065061922E-11;
+  const double t2 = t * t;
+  const double st = t * (1 + t2 * (-1.0 / 6 + t2 * (1.0 / 120 + t2 * (-1.0 / 5040
+      + t2 * (1.0 / 362880)))));
+  const double ct = 1 + t2 * (-0.5 + t2 * (1.0 / 24 + t2 * (-1.0 / 720 + t2 * (1.0 / 40320
+      + t2 * (-1.0 / 3628800)))));
+  const bool odd = q == 1 or q == 3;
+  const double sq = odd ? ct : st;
+  const double cq = odd ? st : ct;
+  *s = q >= 2 ? -sq : sq;
+  *c = q == 1 or q == 2 ? -cq : cq;
+}
+
+// Polynomial atan2 within 5E-10. Both sides of every select are computed,
+// so none of them is a branch around a division.
+inline double fast_atan2(const double y, const double x)
+{
+  const double ax = fabs(x);
+  const double ay = fabs(y);
+  const double t = std::min(ax, ay) / std::max(std::max(ax, ay), DBL_MIN);
+  // Reduce to |z| <= tan(pi/8) with atan(t) = pi/4 + atan((t - 1) / (t + 1))
+  const bool upper = t > 0.41421356237309503;
+  const double reduced = (t - 1) / (t + 1);
+  const double z = upper ? reduced : t;
+  const double z2 = z * z;
+  // Taylor series, of which the first omitted term is below 5E-10
+  const double p = 1 + z2 * (-1.0 / 3 + z2 * (1.0 / 5 + z2 * (-1.0 / 7 + z2 * (1.0 / 9
+      + z2 * (-1.0 / 11 + z2 * (1.0 / 13 + z2 * (-1.0 / 15 + z2 * (1.0 / 17
+      + z2 * (-1.0 / 19)))))))));
+  double angle = z * p + (upper ? 0.78539816339744831 : 0);
+  angle = ay > ax ? 1.5707963267948966 - angle : angle;
+  angle = x < 0 ? 3.1415926535897932 - angle : angle;
+  return copysign(angle, y);
+}
+
+// Trigonometry for solvers templated on the precision
+struct ExactMath {
+  static void sin_cos(const double x, double* s, double* c) {
+    geofun::sin_cos(x, s, c);
   }
-  while (result >= pi) {
-    result -= two_pi;
+  static double cos(const double x) {
+    return ::cos(x);
   }
-  return result;
+  static double atan2(const double y, const double x) {
+    return ::atan2(y, x);
+  }
+};
+
+struct FastMath {
+  static void sin_cos(const double x, double* s, double* c) {
+    fast_sin_cos(x, s, c);
+  }
+  static double cos(const double x) {
+    double s, c;
+    fast_sin_cos(x, &s, &c);
+    return c;
+  }
+  static double atan2(const double y, const double x) {
+    return fast_atan2(y, x);
+  }
+};
+
+// Reference ellipsoid with the derived constants used by the geodesic and
+// rhumb line calculations precomputed
+struct Ellipsoid {
+  constexpr Ellipsoid(const double equatorial_radius, const double polar_radius):
+    a(equatorial_radius),
+    b(polar_radius),
+    f((equatorial_radius - polar_radius) / equatorial_radius),
+    r((equatorial_radius + polar_radius) / 2),
+    sqa(equatorial_radius * equatorial_radius),
+    sqb(polar_radius * polar_radius),
+    ab(equatorial_radius * polar_radius),
+    dsq(equatorial_radius * equatorial_radius - polar_radius * polar_radius),
+    e2(1 - (polar_radius * polar_radius) / (equatorial_radius * equatorial_radius)),
+    ep2((equatorial_radius * equatorial_radius) / (polar_radius * polar_radius) - 1),
+    n((equatorial_radius - polar_radius) / (equatorial_radius + polar_radius)),
+    rectifying_radius((equatorial_radius + polar_radius) / 2 * (1 + n * n / 4 + n * n * n * n / 64)) {}
+
+  static constexpr Ellipsoid from_flattening(const double equatorial_radius,
+      const double inverse_flattening) {
+    return Ellipsoid(equatorial_radius, equatorial_radius * (1 - 1 / inverse_flattening));
+  }
+
+  double reduced_latitude(const double geodetic_latitude) const {
+    return atan2((1 - f) * sin(geodetic_latitude), cos(geodetic_latitude));
+  }
+  // Sine and cosine of the reduced latitude without the round trip through
+  // atan2
+  void reduced_sincos(const double geodetic_latitude, double* sinu, double* cosu) const {
+    double y, x;
+    sin_cos(geodetic_latitude, &y, &x);
+    y *= 1 - f;
+    double h = sqrt(sqr(x) + sqr(y));
+    *sinu = y / h;
+    *cosu = x / h;
+  }
+
+  // Isometric latitude, the Mercator ordinate on a unit equator. Rhumb lines
+  // are straight in (longitude, isometric latitude).
+  double isometric_latitude(const double geodetic_latitude) const {
+    const double e = sqrt(e2);
+    return asinh(tan(geodetic_latitude)) - e * atanh(e * sin(geodetic_latitude));
+  }
+  // Inverse of isometric_latitude by Newton iteration from the spherical
+  // value, which takes three or four steps
+  double geodetic_latitude(const double isometric_latitude) const {
+    double lat = atan(sinh(isometric_latitude));
+    for (int i = 0; i < 10; ++i) {
+      double sinlat = sin(lat);
+      double d = (isometric_latitude - this->isometric_latitude(lat))
+          * (1 - e2 * sqr(sinlat)) * cos(lat) / (1 - e2);
+      lat += d;
+      if (fabs(d) < 1E-15) {
+        break;
+      }
+    }
+    return lat;
+  }
+
+  // Meridian arc length from the equator, from the series for the
+  // rectifying latitude in the third flattening. Terms up to n^4 leave an
+  // error below a micrometer.
+  double meridian_arc(const double geodetic_latitude) const {
+    const double n2 = sqr(n);
+    double s, c;
+    sin_cos(2 * geodetic_latitude, &s, &c);
+    c *= 2;
+    // Clenshaw summation of the sin(2 k lat) terms
+    double u4 = 315.0 / 512 * sqr(n2);
+    double u3 = -35.0 / 48 * n * n2 + c * u4;
+    double u2 = n2 * (15.0 / 16 - 15.0 / 32 * n2) + c * u3 - u4;
+    double u1 = n * (-1.5 + 9.0 / 16 * n2) + c * u2 - u3;
+    return rectifying_radius * (geodetic_latitude + u1 * s);
+  }
+  // Inverse of meridian_arc. The series leaves an error of about 1E-14,
+  // which one Newton step removes so that many short steps don't drift.
+  double meridian_latitude(const double arc) const {
+    const double n2 = sqr(n);
+    const double mu = arc / rectifying_radius;
+    double s, c;
+    sin_cos(2 * mu, &s, &c);
+    c *= 2;
+    double u4 = 1097.0 / 512 * sqr(n2);
+    double u3 = 151.0 / 96 * n * n2 + c * u4;
+    double u2 = n2 * (21.0 / 16 - 55.0 / 32 * n2) + c * u3 - u4;
+    double u1 = n * (1.5 - 27.0 / 32 * n2) + c * u2 - u3;
+    double lat = mu + u1 * s;
+    double w = 1 - e2 * sqr(sin(lat));
+    return lat + (arc - meridian_arc(lat)) * w * sqrt(w) / (a * (1 - e2));
+  }
+  // Radius of the parallel at a latitude
+  double parallel_radius(const double geodetic_latitude) const {
+    double s, c;
+    sin_cos(geodetic_latitude, &s, &c);
+    return a * c / sqrt(1 - e2 * sqr(s));
+  }
+  // Meridian arc length from the equator to a pole
+  double quarter_meridian() const {
+    return rectifying_radius * half_pi;
+  }
+
+  double a;    // equatorial radius
+  double b;    // polar radius
+  double f;    // flattening
+  double r;    // average radius
+  double sqa;  // a^2
+  double sqb;  // b^2
+  double ab;   // a * b
+  double dsq;  // a^2 - b^2
+  double e2;   // first eccentricity squared
+  double ep2;  // second eccentricity squared
+  double n;    // third flattening
+  double rectifying_radius;  // meridian arc per radian of rectifying latitude
+};
+
+static constexpr Ellipsoid wgs84_ellipsoid(a, b);
+static constexpr Ellipsoid grs80_ellipsoid = Ellipsoid::from_flattening(6378137.0, 298.257222101);
+static constexpr Ellipsoid international1924_ellipsoid = Ellipsoid::from_flattening(6378388.0, 297.0);
+static constexpr Ellipsoid sphere_ellipsoid(r, r);
+
+inline double reduced_latitude(const double geodetic_latitude) 
+{
+  return wgs84_ellipsoid.reduced_latitude(geodetic_latitude);
+}
+
+// The angle normalizations take whole turns off in one step, so they take
+// the same time for any angle. The last step corrects rounding at the ends
+// of the range.
+inline double angle_pipi(const double angle)
+{
+  double result = angle - two_pi * floor((angle + pi) * (1 / two_pi));
+  result = result < -pi ? result + two_pi : result;
+  return result >= pi ? result - two_pi : result;
 }
 
 inline double angle_2pi(const double angle)
 {
-  double result = angle;
-  while (result < 0) {
-    result += two_pi;
-  }
-  while (result >= two_pi) {
-    result -= two_pi;
-  }
-  return result;
+  double result = angle - two_pi * floor(angle * (1 / two_pi));
+  result = result < 0 ? result + two_pi : result;
+  return result >= two_pi ? result - two_pi : result;
 }
 
 inline bool angle_pi2pi2(double* angle)
@@ -129,7 +332,8 @@ private:
 struct EarthModelError {
   EarthModelError() {} 
   const char* what() const throw() {
-    return "Unknown earth model. Available are: \"wgs84\", \"spherical\"";
+    return "Unknown earth model. Available are: \"wgs84\", \"spherical\", "
+        "\"grs80\", \"international1924\", \"wgs84_table\"";
   }
 };
   
@@ -140,6 +344,63 @@ struct AngleModeError {
   }
 };
 
+// Plain value types for hot paths. Unlike Coord, Vector and Position these
+// have no virtual methods: they are trivially copyable and standard layout,
+// so they pack tightly in arrays and can be copied with memcpy. Angles are
+// always in radians, the angle mode does not apply.
+struct CoordValue {
+  double x;
+  double y;
+};
+
+struct VectorValue {
+  double a;
+  double r;
+};
+
+struct PositionValue {
+  double lat;
+  double lon;
+};
+
+static_assert(std::is_trivially_copyable<CoordValue>::value
+    and std::is_standard_layout<CoordValue>::value
+    and sizeof(CoordValue) == 2 * sizeof(double), "CoordValue is not POD");
+static_assert(std::is_trivially_copyable<VectorValue>::value
+    and std::is_standard_layout<VectorValue>::value
+    and sizeof(VectorValue) == 2 * sizeof(double), "VectorValue is not POD");
+static_assert(std::is_trivially_copyable<PositionValue>::value
+    and std::is_standard_layout<PositionValue>::value
+    and sizeof(PositionValue) == 2 * sizeof(double), "PositionValue is not POD");
+
+inline CoordValue operator+(const CoordValue& c1, const CoordValue& c2)
+{
+  CoordValue result = {c1.x + c2.x, c1.y + c2.y};
+  return result;
+}
+
+inline CoordValue operator-(const CoordValue& c1, const CoordValue& c2)
+{
+  CoordValue result = {c1.x - c2.x, c1.y - c2.y};
+  return result;
+}
+
+inline CoordValue operator*(const double value, const CoordValue& c)
+{
+  CoordValue result = {value * c.x, value * c.y};
+  return result;
+}
+
+inline double dot(const CoordValue& c1, const CoordValue& c2)
+{
+  return c1.x * c2.x + c1.y * c2.y;
+}
+
+inline double cross(const CoordValue& c1, const CoordValue& c2)
+{
+  return c1.x * c2.y - c1.y * c2.x;
+}
+
 struct Simple {
   virtual ~Simple() {}
   virtual double operator[](int i) const {
@@ -162,6 +423,7 @@ struct Coord: Simple {
   Coord(): _x(0), _y(0) {}
   Coord(const double x, const double y): _x(x), _y(y) {}
   Coord(const Coord& coord): _x(coord._x), _y(coord._y) {}
+  Coord(const CoordValue& coord): _x(coord.x), _y(coord.y) {}
   Coord& operator=(const Coord& value) {
     _x = value._x;
     _y = value._y;
@@ -236,6 +498,10 @@ struct Coord: Simple {
   void set_y(const double value) {
     _y = value;
   }
+  CoordValue value() const {
+    CoordValue result = {_x, _y};
+    return result;
+  }
 private:
   double _x;
   double _y;
@@ -253,35 +519,404 @@ inline Coord operator/(const double value, const Coord& coord)
   return Coord(value / coord.get_x(), value / coord.get_y());
 }
 
+// Normalize latitude to [-pi/2, pi/2] and longitude to [-pi, pi). Passing
+// over a pole flips the longitude.
+inline void normalize_latlon(double* lat, double* lon)
+{
+  *lon = angle_pipi(*lon);
+  if (angle_pi2pi2(lat)) {
+    *lon = angle_pipi(*lon + pi);
+  }
+}
+
+// Below this latitude difference the ratio of meridian arc to isometric
+// latitude loses precision, and the radius of the parallel halfway is used
+static const double rhumb_parallel_dlat = 5E-6;
+
+// Closed form rhumb line navigation on an ellipsoid. The meridian arc gives
+// the latitude, the isometric latitude the longitude, so there is no
+// integration error and many short steps add up to one long step. Meridian
+// is an Ellipsoid or anything with the same latitude functions, like
+// TableEarthModel.
+template <class Meridian>
+inline void ellipsoid_rhumb_direct(const Meridian& e, const double lat1, const double lon1,
+    const double azimuth, const double range, double* lat2, double* lon2)
+{
+  const double quarter = e.quarter_meridian();
+  double sina, cosa;
+  sin_cos(azimuth, &sina, &cosa);
+  double arc = e.meridian_arc(lat1) + range * cosa;
+  if (fabs(arc) > quarter) {
+    // Only a meridian reaches a pole at a finite distance. Continue like one
+    // on the other side.
+    *lat2 = e.meridian_latitude((arc > 0 ? 2 : -2) * quarter - arc);
+    *lon2 = angle_pipi(lon1 + pi);
+    return;
+  }
+  *lat2 = e.meridian_latitude(arc);
+  double dlon;
+  if (fabs(*lat2 - lat1) < rhumb_parallel_dlat) {
+    dlon = range * sina / e.parallel_radius(0.5 * (lat1 + *lat2));
+  } else {
+    dlon = (e.isometric_latitude(*lat2) - e.isometric_latitude(lat1)) * sina / cosa;
+  }
+  // At a pole the longitude is arbitrary
+  *lon2 = std::isfinite(dlon) ? angle_pipi(lon1 + dlon) : angle_pipi(lon1);
+}
+
+template <class Meridian>
+inline void ellipsoid_rhumb_inverse(const Meridian& e, const double lat1, const double lon1,
+    const double lat2, const double lon2, double* azimuth, double* range)
+{
+  double dlon = angle_diff(lon2, lon1);
+  double darc = e.meridian_arc(lat2) - e.meridian_arc(lat1);
+  double east;
+  if (fabs(lat2 - lat1) < rhumb_parallel_dlat) {
+    east = dlon * e.parallel_radius(0.5 * (lat1 + lat2));
+  } else {
+    east = dlon * darc / (e.isometric_latitude(lat2) - e.isometric_latitude(lat1));
+  }
+  // Zero towards a pole
+  if (not std::isfinite(east)) {
+    east = 0;
+  }
+  *range = sqrt(sqr(darc) + sqr(east));
+  *azimuth = angle_2pi(atan2(east, darc));
+}
+
+// Rhumb line navigation by Simpson integration of the cartesian deltas of
+// model. When Model is a concrete model like WGS84 or Sphere, the deltas are
+// resolved at compile time and can be inlined.
+template <class Model>
+inline void simpson_rhumb_direct(Model& model, const double lat1, const double lon1,
+    const double azimuth, const double range, double* lat2, double* lon2)
+{
+  CoordValue cart = {range * cos(azimuth), range * sin(azimuth)};
+  CoordValue deltas1 = model.deltas(lat1);
+  double mid_lat = lat1 + 0.5 * cart.x / deltas1.x;
+  angle_pi2pi2(&mid_lat);
+  CoordValue deltas2 = model.deltas(mid_lat);
+  mid_lat = lat1 + cart.x / (deltas1.x + deltas2.x);
+  angle_pi2pi2(&mid_lat);
+  deltas2 = model.deltas(mid_lat);
+  double end_lat = lat1 + cart.x / deltas2.x;
+  angle_pi2pi2(&end_lat);
+  CoordValue deltas3 = model.deltas(end_lat);
+  *lat2 = lat1 + cart.x * (1.0 / 6) * (1 / deltas1.x + 4 / deltas2.x + 1 / deltas3.x);
+  *lon2 = lon1 + cart.y * (1.0 / 6) * (1 / deltas1.y + 4 / deltas2.y + 1 / deltas3.y);
+  normalize_latlon(lat2, lon2);
+}
+
+template <class Model>
+inline void simpson_rhumb_inverse(Model& model, const double lat1, const double lon1,
+    const double lat2, const double lon2, double* azimuth, double* range)
+{
+  double dlat = angle_diff(lat2, lat1);
+  double dlon = angle_diff(lon2, lon1);
+  CoordValue deltas1 = model.deltas(lat1);
+  CoordValue deltas2 = model.deltas(0.5 * (lat1 + lat2));
+  CoordValue deltas3 = model.deltas(lat2);
+  double x = dlat * 6.0 / (1.0 / deltas1.x + 4.0 / deltas2.x + 1.0 / deltas3.x);
+  double y = dlon * 6.0 / (1.0 / deltas1.y + 4.0 / deltas2.y + 1.0 / deltas3.y);
+  *range = sqrt(sqr(x) + sqr(y));
+  *azimuth = angle_2pi(atan2(y, x));
+}
+
+// Rhumb line navigation with the earth model fixed at compile time, e.g.
+// rhumb_direct<WGS84>(...). No virtual calls are involved.
+template <class Model>
+inline void rhumb_direct(const double lat1, const double lon1,
+    const double azimuth, const double range, double* lat2, double* lon2)
+{
+  ellipsoid_rhumb_direct(Model::ellipsoid(), lat1, lon1, azimuth, range, lat2, lon2);
+}
+
+template <class Model>
+inline void rhumb_inverse(const double lat1, const double lon1,
+    const double lat2, const double lon2, double* azimuth, double* range)
+{
+  ellipsoid_rhumb_inverse(Model::ellipsoid(), lat1, lon1, lat2, lon2, azimuth, range);
+}
+
 struct EarthModel {
   virtual ~EarthModel() {}
   virtual Coord cartesian_deltas(const double lat) {
     return Coord(1, 1);
   };
+  CoordValue deltas(const double lat) {
+    return cartesian_deltas(lat).value();
+  }
+  // Ellipsoid used for geodesics (Arc) on this model
+  virtual const Ellipsoid& get_ellipsoid() const {
+    return wgs84_ellipsoid;
+  }
+  // Models override these to do a rhumb line calculation with a single
+  // virtual call
+  virtual void rhumb_direct(const double lat1, const double lon1,
+      const double azimuth, const double range, double* lat2, double* lon2) {
+    simpson_rhumb_direct(*this, lat1, lon1, azimuth, range, lat2, lon2);
+  }
+  virtual void rhumb_inverse(const double lat1, const double lon1,
+      const double lat2, const double lon2, double* azimuth, double* range) {
+    simpson_rhumb_inverse(*this, lat1, lon1, lat2, lon2, azimuth, range);
+  }
 };
 
-struct Sphere: EarthModel {
+inline CoordValue ellipsoid_deltas(const Ellipsoid& e, const double lat)
+{
+  double rl = e.reduced_latitude(lat);
+  CoordValue result = {
+      e.ab * sqrt(e.sqa * sqr(sin(rl)) + e.sqb * sqr(cos(rl)))
+          / (e.dsq * sqr(cos(lat)) + e.sqb),
+      e.a * cos(rl)};
+  return result;
+}
+
+// Helper implementing the virtual interface of a model in terms of the
+// static deltas and ellipsoid functions of Model
+template <class Model>
+struct StaticEarthModel: EarthModel {
   virtual Coord cartesian_deltas(const double lat) {
-    return Coord(r, r * cos(lat));
+    return Coord(Model::deltas(lat));
+  }
+  virtual const Ellipsoid& get_ellipsoid() const {
+    return Model::ellipsoid();
+  }
+  virtual void rhumb_direct(const double lat1, const double lon1,
+      const double azimuth, const double range, double* lat2, double* lon2) {
+    geofun::rhumb_direct<Model>(lat1, lon1, azimuth, range, lat2, lon2);
+  }
+  virtual void rhumb_inverse(const double lat1, const double lon1,
+      const double lat2, const double lon2, double* azimuth, double* range) {
+    geofun::rhumb_inverse<Model>(lat1, lon1, lat2, lon2, azimuth, range);
+  }
+};
+
+struct Sphere: StaticEarthModel<Sphere> {
+  static const Ellipsoid& ellipsoid() {
+    return sphere_ellipsoid;
+  }
+  static CoordValue deltas(const double lat) {
+    CoordValue result = {r, r * cos(lat)};
+    return result;
+  }
+};
+
+struct WGS84: StaticEarthModel<WGS84> {
+  static const Ellipsoid& ellipsoid() {
+    return wgs84_ellipsoid;
+  }
+  static CoordValue deltas(const double lat) {
+    return ellipsoid_deltas(wgs84_ellipsoid, lat);
   }
 };
 
-struct WGS84: EarthModel {
+struct GRS80: StaticEarthModel<GRS80> {
+  static const Ellipsoid& ellipsoid() {
+    return grs80_ellipsoid;
+  }
+  static CoordValue deltas(const double lat) {
+    return ellipsoid_deltas(grs80_ellipsoid, lat);
+  }
+};
+
+struct International1924: StaticEarthModel<International1924> {
+  static const Ellipsoid& ellipsoid() {
+    return international1924_ellipsoid;
+  }
+  static CoordValue deltas(const double lat) {
+    return ellipsoid_deltas(international1924_ellipsoid, lat);
+  }
+};
+
+// Earth model for an ellipsoid chosen at run time, e.g. a local datum or
+// sphere
+struct EllipsoidModel: EarthModel {
+  EllipsoidModel(const Ellipsoid& ellipsoid): _ellipsoid(ellipsoid) {}
   virtual Coord cartesian_deltas(const double lat) {
-    double rl = reduced_latitude(lat);
-    return Coord(
-        a * b * sqrt(sqa * sqr(sin(rl)) + sqb * sqr(cos(rl))) 
-            / ((sqa - sqb) * sqr(cos(lat)) + sqb),
-        a * cos(rl));
+    return Coord(deltas(lat));
+  }
+  virtual const Ellipsoid& get_ellipsoid() const {
+    return _ellipsoid;
+  }
+  CoordValue deltas(const double lat) const {
+    return ellipsoid_deltas(_ellipsoid, lat);
+  }
+  virtual void rhumb_direct(const double lat1, const double lon1,
+      const double azimuth, const double range, double* lat2, double* lon2) {
+    ellipsoid_rhumb_direct(_ellipsoid, lat1, lon1, azimuth, range, lat2, lon2);
+  }
+  virtual void rhumb_inverse(const double lat1, const double lon1,
+      const double lat2, const double lon2, double* azimuth, double* range) {
+    ellipsoid_rhumb_inverse(_ellipsoid, lat1, lon1, lat2, lon2, azimuth, range);
+  }
+private:
+  Ellipsoid _ellipsoid;
+};
+
+// Latitude up to which TableEarthModel tabulates the isometric latitude
+static const double table_isometric_limit = 80 * pi / 180;
+
+// Cubic Hermite interpolation of a smooth function from its values and
+// slopes on a uniform grid
+struct HermiteTable {
+  HermiteTable(): _x0(0), _scale(1), _last(0) {}
+  HermiteTable(const double x0, const double x1,
+      const std::vector<double>& values, const std::vector<double>& slopes);
+  double operator()(const double x) const {
+    double t;
+    const double* node = find(x, &t);
+    const double c = node[2] - node[0];
+    return node[0] + t * (node[1] + t * ((3 * c - 2 * node[1] - node[3])
+        + t * (node[1] + node[3] - 2 * c)));
+  }
+  double slope(const double x) const {
+    double t;
+    const double* node = find(x, &t);
+    const double c = node[2] - node[0];
+    return (node[1] + t * (2 * (3 * c - 2 * node[1] - node[3])
+        + 3 * t * (node[1] + node[3] - 2 * c))) * _scale;
   }
+private:
+  // Node starting the interval of x, and the position of x in it
+  const double* find(const double x, double* t) const {
+    const double u = (x - _x0) * _scale;
+    const int i = std::min(std::max(static_cast<int>(floor(u)), 0), _last);
+    *t = u - i;
+    return &_nodes[2 * i];
+  }
+
+  double _x0;
+  double _scale;               // intervals per unit of x
+  int _last;                   // index of the last interval
+  std::vector<double> _nodes;  // value and slope times interval per node
 };
 
+// Earth model interpolating the meridian arc, its inverse and the isometric
+// latitude of an ellipsoid from tables, which saves most of the
+// transcendental functions of a rhumb line calculation. Past
+// table_isometric_limit, where the isometric latitude grows too steep to
+// tabulate, the exact functions are used. Against the exact model the
+// tables add an error below 1E-8 of the distance to rhumb line ranges
+// and positions, plus at most 1E-7 m.
+struct TableEarthModel: EarthModel {
+  TableEarthModel(const Ellipsoid& ellipsoid);
+  virtual Coord cartesian_deltas(const double lat);
+  virtual const Ellipsoid& get_ellipsoid() const {
+    return _ellipsoid;
+  }
+  virtual void rhumb_direct(const double lat1, const double lon1,
+      const double azimuth, const double range, double* lat2, double* lon2) {
+    ellipsoid_rhumb_direct(*this, lat1, lon1, azimuth, range, lat2, lon2);
+  }
+  virtual void rhumb_inverse(const double lat1, const double lon1,
+      const double lat2, const double lon2, double* azimuth, double* range) {
+    ellipsoid_rhumb_inverse(*this, lat1, lon1, lat2, lon2, azimuth, range);
+  }
 
+  // Latitude functions of Ellipsoid for ellipsoid_rhumb_direct and
+  // ellipsoid_rhumb_inverse
+  double meridian_arc(const double geodetic_latitude) const {
+    return _arc(geodetic_latitude);
+  }
+  double meridian_latitude(const double arc) const {
+    return _latitude(arc);
+  }
+  double isometric_latitude(const double geodetic_latitude) const {
+    if (fabs(geodetic_latitude) > table_isometric_limit) {
+      return _ellipsoid.isometric_latitude(geodetic_latitude);
+    }
+    return _isometric(geodetic_latitude);
+  }
+  // The meridian arc and isometric latitude change with the radii of the
+  // meridian and the parallel respectively
+  double parallel_radius(const double geodetic_latitude) const {
+    if (fabs(geodetic_latitude) > table_isometric_limit) {
+      return _ellipsoid.parallel_radius(geodetic_latitude);
+    }
+    return _arc.slope(geodetic_latitude) / _isometric.slope(geodetic_latitude);
+  }
+  double quarter_meridian() const {
+    return _ellipsoid.quarter_meridian();
+  }
+private:
+  Ellipsoid _ellipsoid;
+  HermiteTable _arc;         // meridian arc by latitude
+  HermiteTable _latitude;    // latitude by meridian arc
+  HermiteTable _isometric;   // isometric latitude up to table_isometric_limit
+};
+
+
+// The angle mode and earth model are settings of the calling thread. A new
+// thread starts out with radians and the WGS84 model.
 extern EarthModel* get_earth_model();
 extern void set_earth_model(const std::string& model_name);
+// Use a custom model. The model must outlive its use.
+extern void set_earth_model(EarthModel& model);
 extern void set_angle_mode(const std::string& angle_mode);
 typedef enum {am_radians, am_degrees} AngleMode;
-extern AngleMode angle_mode;
+extern thread_local AngleMode angle_mode;
+
+// Convergence threshold of the Vincenty iterations: the change in radians of
+// the iterated angle between two steps. Distances come out within about the
+// tolerance times the earth radius, so the default is good to a meter and
+// 1E-9 to a centimeter. This too is a setting of the calling thread.
+static const double default_vincenty_tolerance = 1E-7;
+extern double get_vincenty_tolerance();
+extern void set_vincenty_tolerance(const double tolerance);
+
+// Precision of the trigonometry in the Vincenty solvers of Arc and the batch
+// functions. mp_fast moves positions by up to about a centimeter. Rhumb
+// lines, Line and the other spherical helpers always use libm. This too is
+// a setting of the calling thread.
+extern MathPrecision get_math_precision();
+extern void set_math_precision(const MathPrecision precision);
+
+// Upper bound for the number of Vincenty iterations. Nearly antipodal pairs
+// that don't converge within it are solved with a bisection instead.
+static const int vincenty_max_iterations = 100;
+
+// How a Vincenty solution was obtained
+typedef enum {vs_converged, vs_fallback, vs_max_iterations} VincentyStatus;
+
+// Fallback for the Vincenty inverse. Bisects the azimuth at position 1 to
+// match the longitude difference dl, which works for any pair of positions
+// including (nearly) antipodal and coincident ones. Takes the sines and
+// cosines of the reduced latitudes and yields the distance, and the forward
+// azimuths at both positions.
+extern void vincenty_inverse_fallback(const double sinu1, const double cosu1,
+    const double sinu2, const double cosu2, const double dl, const Ellipsoid& e,
+    double* distance, double* azimuth1, double* azimuth2);
+
+// Angle mode, earth model, Vincenty tolerance and math precision as a unit
+// that can be passed to worker threads and installed there with set_context
+// or ScopedContext
+struct Context {
+  Context(): angle_mode(am_radians), earth_model(0),
+    vincenty_tolerance(default_vincenty_tolerance), math_precision(mp_exact) {}
+  Context(const std::string& angle_mode_name, const std::string& earth_model_name);
+  AngleMode angle_mode;
+  EarthModel* earth_model; // 0 selects the default model
+  double vincenty_tolerance;
+  MathPrecision math_precision;
+};
+
+extern Context get_context();
+extern void set_context(const Context& context);
+
+// Installs a context for the current thread for the lifetime of the object
+struct ScopedContext {
+  ScopedContext(const Context& context): _saved(get_context()) {
+    set_context(context);
+  }
+  ~ScopedContext() {
+    set_context(_saved);
+  }
+private:
+  ScopedContext(const ScopedContext&);
+  ScopedContext& operator=(const ScopedContext&);
+  Context _saved;
+};
 
 inline double from_rads(const double value)
 {
@@ -315,11 +950,97 @@ inline double from_degs(const double value)
     return value * pi / 180;
 }
 
+// Angle units fixed at compile time, for use with the unit templated
+// constructors and accessors of Vector and Position. These don't depend on
+// the angle mode.
+struct Radians {
+  static double to_rads(const double value) {
+    return value;
+  }
+  static double from_rads(const double value) {
+    return value;
+  }
+};
+
+struct Degrees {
+  static double to_rads(const double value) {
+    return value * pi / 180;
+  }
+  static double from_rads(const double value) {
+    return value * 180 / pi;
+  }
+};
+
+// Rhumb line navigation on the current earth model in radians. These
+// implement Position + Vector and Position - Position.
+extern void rhumb_direct(const double lat1, const double lon1,
+    const double azimuth, const double range, double* lat2, double* lon2);
+extern void rhumb_inverse(const double lat1, const double lon1,
+    const double lat2, const double lon2, double* azimuth, double* range);
+// Crossing of the rhumb lines from position 1 to 2 and from position 3 to 4
+// in radians, solved in closed form as the crossing of straight lines in
+// (longitude, isometric latitude). Yields the crossing of the extended lines
+// and returns whether it lies on both segments. Returns false without a
+// result for parallel lines.
+extern bool rhumb_intersection(const double lat1, const double lon1,
+    const double lat2, const double lon2,
+    const double lat3, const double lon3,
+    const double lat4, const double lon4,
+    double* lat, double* lon);
+
+inline CoordValue cartesian(const VectorValue& v)
+{
+  CoordValue result = {v.r * cos(v.a), v.r * sin(v.a)};
+  return result;
+}
+
+inline VectorValue polar(const CoordValue& c)
+{
+  VectorValue result = {angle_2pi(atan2(c.y, c.x)), hypot(c.x, c.y)};
+  return result;
+}
+
+inline VectorValue operator-(const VectorValue& v)
+{
+  VectorValue result = {angle_2pi(v.a + pi), v.r};
+  return result;
+}
+
+inline PositionValue& operator+=(PositionValue& p, const VectorValue& v)
+{
+  rhumb_direct(p.lat, p.lon, v.a, v.r, &p.lat, &p.lon);
+  return p;
+}
+
+inline PositionValue operator+(const PositionValue& p, const VectorValue& v)
+{
+  PositionValue result = p;
+  result += v;
+  return result;
+}
+
+inline PositionValue operator-(const PositionValue& p, const VectorValue& v)
+{
+  return p + -v;
+}
+
+// Rhumb line vector from p1 to p2
+inline VectorValue operator-(const PositionValue& p2, const PositionValue& p1)
+{
+  VectorValue result;
+  rhumb_inverse(p1.lat, p1.lon, p2.lat, p2.lon, &result.a, &result.r);
+  return result;
+}
+
 
 struct Vector: Simple {
   Vector(): _a(0), _r(0) {}
   Vector(const double angle, const double range): _a(angle_2pi(to_rads(angle))), _r(range) {}
+  template <class Unit>
+  Vector(const double angle, const double range, Unit):
+    _a(angle_2pi(Unit::to_rads(angle))), _r(range) {}
   Vector(const Vector& vector): _a(vector._a), _r(vector._r) {}
+  Vector(const VectorValue& vector): _a(angle_2pi(vector.a)), _r(vector.r) {}
   Vector(const Coord& coord) {
     _r = sqrt(sqr(coord.get_x()) + sqr(coord.get_y()));
     _a = angle_2pi(atan2(coord.get_y(), coord.get_x()));
@@ -415,6 +1136,18 @@ struct Vector: Simple {
   void set_a(const double value) {
     _set_a(to_rads(value));
   }
+  template <class Unit>
+  double get_a() const {
+    return Unit::from_rads(_a);
+  }
+  template <class Unit>
+  void set_a(const double value) {
+    _set_a(Unit::to_rads(value));
+  }
+  VectorValue value() const {
+    VectorValue result = {_a, _r};
+    return result;
+  }
   friend class Line;
   friend class Arc;
 private:
@@ -454,7 +1187,14 @@ struct Position: Simple {
   Position(const double latitude, const double longitude): _lat(0), _lon(0) {
     set_latlon(latitude, longitude);
   }
+  template <class Unit>
+  Position(const double latitude, const double longitude, Unit): _lat(0), _lon(0) {
+    _set_latlon(Unit::to_rads(latitude), Unit::to_rads(longitude));
+  }
   Position(const Position& position): _lat(position._lat), _lon(position._lon) {}
+  Position(const PositionValue& position): _lat(0), _lon(0) {
+    _set_latlon(position.lat, position.lon);
+  }
   Position(const Simple& position): _lat(0), _lon(0) {
     *this = position;
   }
@@ -551,9 +1291,25 @@ struct Position: Simple {
     set_lon(longitude);
     set_lat(latitude);
   }
+  template <class Unit>
+  double get_lat() const {
+    return Unit::from_rads(_lat);
+  }
+  template <class Unit>
+  double get_lon() const {
+    return Unit::from_rads(_lon);
+  }
+  template <class Unit>
+  void set_latlon(const double latitude, const double longitude) {
+    _set_latlon(Unit::to_rads(latitude), Unit::to_rads(longitude));
+  }
   Coord cartesian_deltas(void) const {
     return get_earth_model()->cartesian_deltas(_lat);
   }
+  PositionValue value() const {
+    PositionValue result = {_lat, _lon};
+    return result;
+  }
 private:
   friend class Line;
   friend class Arc;
@@ -646,26 +1402,35 @@ private:
 };
 
 struct Arc: Complex {
-  Arc(): _p1(), _p2(), _v(), _r() {}
-  Arc(const Position& p1, const Position& p2): _p1(p1), _p2(p2) {
-    vincenty_inverse(p1, p2, &_v, &_r, &_alpha);
-  }
-  Arc(const Position& p1, const Vector& v): _p1(p1), _v(v) {
-    vincenty_direct(p1, v, &_p2, &_r, &_alpha);
-  }
-  Arc(const Arc& arc): _p1(arc._p1), _p2(arc._p2), _v(arc._v), _r(arc._r) {}
+  // An arc keeps the ellipsoid of the earth model it was solved on, and
+  // answers later queries and updates on that ellipsoid
+  Arc(): _p1(), _p2(), _v(), _r(), _alpha(0), _status(vs_converged),
+    _ellipsoid(get_earth_model()->get_ellipsoid()) {}
+  Arc(const Position& p1, const Position& p2): _p1(p1), _p2(p2),
+    _ellipsoid(get_earth_model()->get_ellipsoid()) {
+    _status = vincenty_inverse(p1, p2, &_v, &_r, &_alpha, _ellipsoid);
+  }
+  Arc(const Position& p1, const Vector& v): _p1(p1), _v(v),
+    _ellipsoid(get_earth_model()->get_ellipsoid()) {
+    _status = vincenty_direct(p1, v, &_p2, &_r, &_alpha, _ellipsoid);
+  }
+  Arc(const Arc& arc): _p1(arc._p1), _p2(arc._p2), _v(arc._v), _r(arc._r),
+    _alpha(arc._alpha), _status(arc._status), _ellipsoid(arc._ellipsoid) {}
   Arc& operator=(const Arc& arc) {
     _p1 = arc._p1;
     _p2 = arc._p2;
     _v = arc._v;
     _r = arc._r;
+    _alpha = arc._alpha;
+    _status = arc._status;
+    _ellipsoid = arc._ellipsoid;
     return *this;
   }
   Arc& operator+=(const Vector& vector) {
     Position p;
     Vector r;
     double alpha;
-    vincenty_direct(_p2, vector, &p, &r, &alpha);
+    vincenty_direct(_p2, vector, &p, &r, &alpha, _ellipsoid);
     set_p2(p);
     return *this;
   }
@@ -696,49 +1461,85 @@ struct Arc: Complex {
   }
   void set_p1(const Position& position) {
     _p1 = position;
-    vincenty_inverse(_p1, _p2, &_v, &_r, &_alpha);
+    _status = vincenty_inverse(_p1, _p2, &_v, &_r, &_alpha, _ellipsoid);
   }
   void set_p2(const Position& position) {
     _p2 = position;
-    vincenty_inverse(_p1, _p2, &_v, &_r, &_alpha);
+    _status = vincenty_inverse(_p1, _p2, &_v, &_r, &_alpha, _ellipsoid);
   }
   void set_v(const Vector& vector) {
     _v = vector;
-    vincenty_direct(_p1, vector, &_p2, &_r, &_alpha);
+    _status = vincenty_direct(_p1, vector, &_p2, &_r, &_alpha, _ellipsoid);
   }
   void set_r(const Vector& vector) {
     _r = vector;
-    vincenty_direct(_p2, vector, &_p1, &_v, &_alpha);
+    _status = vincenty_direct(_p2, vector, &_p1, &_v, &_alpha, _ellipsoid);
+  }
+  // How the last solution of the arc was obtained
+  VincentyStatus get_status() const {
+    return _status;
   }
+  // Latitude bounds include the vertex of the geodesic when the arc passes
+  // it. Longitudes run eastward from min_lon to max_lon, like for Line.
   double min_lat() const {
-    // TODO
-    return std::min(_p1.get_lat(), _p2.get_lat());
+    double lat1, lat2;
+    lat_bounds(&lat1, &lat2);
+    return from_rads(lat1);
   }
   double max_lat() const {
-    // TODO
-    return std::max(_p1.get_lat(), _p2.get_lat());
+    double lat1, lat2;
+    lat_bounds(&lat1, &lat2);
+    return from_rads(lat2);
   }
   double min_lon() const {
-    return std::min(_p1.get_lon(), _p1.get_lon());
+    return _v._a <= pi ? _p1.get_lon() : _p2.get_lon();
   }
   double max_lon() const {
-    return std::max(_p1.get_lon(), _p2.get_lon());
+    return _v._a <= pi ? _p2.get_lon() : _p1.get_lon();
   }
   bool intersects(const Line& line) const;
   Position intersection(const Line& line) const;
   bool intersects(const Arc& arc) const;
   Position intersection(const Arc& arc) const;
+  friend VincentyStatus vincenty_inverse(const PositionValue& p1, const PositionValue& p2,
+      const Ellipsoid& ellipsoid, double* distance, double* azimuth, double* reverse_azimuth);
 protected:
-  static void vincenty_inverse(const Position& p1, const Position& p2, Vector* v, Vector* r, double* alpha);
-  static void vincenty_direct(const Position& p1, const Vector& v, Position* p2, Vector* r, double* alpha);
+  static VincentyStatus vincenty_inverse(const Position& p1, const Position& p2,
+      Vector* v, Vector* r, double* alpha,
+      const Ellipsoid& ellipsoid = get_earth_model()->get_ellipsoid());
+  static VincentyStatus vincenty_direct(const Position& p1, const Vector& v,
+      Position* p2, Vector* r, double* alpha,
+      const Ellipsoid& ellipsoid = get_earth_model()->get_ellipsoid());
 private:
+  template <class Math>
+  static VincentyStatus solve_inverse(const Position& p1, const Position& p2,
+      Vector* v, Vector* r, double* alpha, const Ellipsoid& e);
+  template <class Math>
+  static VincentyStatus solve_direct(const Position& p1, const Vector& v,
+      Position* p2, Vector* r, double* alpha, const Ellipsoid& e);
+  void lat_bounds(double* min_lat, double* max_lat) const;
+  void box(double* box) const;
+  void along(const double s, PositionValue* p, double* azimuth) const;
+  bool find_intersection(const Line& line, Position* x) const;
+  bool find_intersection(const Arc& arc, Position* x) const;
+
   Position _p1;
   Position _p2;
   Vector _v;     // forward vector
   Vector _r;     // reverse vector
   double _alpha; // azimuth at equator
+  VincentyStatus _status;
+  Ellipsoid _ellipsoid;
 };
 
+// Vincenty inverse for one pair of positions in radians on an explicit
+// ellipsoid, solved as Arc(p1, p2) does. The reverse azimuth, when given, is
+// that of get_r(). Single pairs are cheaper here than in the batch kernel,
+// which would solve a whole block of lanes for them.
+extern VincentyStatus vincenty_inverse(const PositionValue& p1, const PositionValue& p2,
+    const Ellipsoid& ellipsoid, double* distance, double* azimuth,
+    double* reverse_azimuth = 0);
+
 };  // namespace geofun
 
 #endif // __GEOFUN_H
@@ -12,6 +12,14 @@
 
 %{
 #include "geofun.hpp"
+#include "geofun_batch.hpp"
+#include "geofun_track.hpp"
+#include "geofun_file.hpp"
+#include "geofun_nvector.hpp"
+#include "geofun_local.hpp"
+#include "geofun_index.hpp"
+
+#include <limits>
 
 // --> for bad_cast
 #include <typeinfo>
@@ -45,8 +53,110 @@
   }
 }
 
+%exception geofun::Context::Context {
+  try {
+    $action
+  } 
+  catch (const geofun::EarthModelError& e) {
+    SWIG_exception(SWIG_ValueError, e.what());
+  }
+  catch (const geofun::AngleModeError& e) {
+    SWIG_exception(SWIG_ValueError, e.what());
+  }
+}
+
+/* Python code should use set_context instead */
+%ignore geofun::ScopedContext;
+
+/* Radian helpers with pointer arguments are replaced by the array
+   functions below */
+%ignore geofun::normalize_latlon;
+/* The plain value types are for C++ hot paths only */
+%ignore geofun::CoordValue;
+%ignore geofun::VectorValue;
+%ignore geofun::PositionValue;
+%ignore geofun::HermiteTable;
+%ignore geofun::sin_cos;
+%ignore geofun::fast_sin_cos;
+%ignore geofun::ExactMath;
+%ignore geofun::FastMath;
+%ignore geofun::Coord::Coord(const CoordValue&);
+%ignore geofun::Vector::Vector(const VectorValue&);
+%ignore geofun::Position::Position(const PositionValue&);
+%ignore *::value;
+%ignore geofun::dot;
+%ignore geofun::cross;
+%ignore geofun::cartesian;
+%ignore geofun::polar;
+%ignore geofun::rhumb_direct;
+%ignore geofun::rhumb_inverse;
+%ignore geofun::ellipsoid_rhumb_direct;
+%ignore geofun::ellipsoid_rhumb_inverse;
+%ignore geofun::vincenty_inverse_fallback;
+%ignore geofun::vincenty_inverse;
+%ignore geofun::rhumb_intersection;
+
 %include "geofun.hpp"
 
+/* The radian arrays overloads are for C++; Python has write_arrays and
+   MappedFile below */
+%ignore geofun::Track::append(const int, const double*, const double*, const double*);
+%ignore geofun::Track::offsets;
+%ignore geofun::FileWriter::write(const int, const double*, const double*,
+    const double*, const double*);
+%ignore geofun::LocalProjection::to_coord(const PositionValue&) const;
+%ignore geofun::LocalProjection::to_position(const CoordValue&) const;
+%ignore geofun::LocalProjection::to_coord(const int, const double*, const double*,
+    double*, double*) const;
+%ignore geofun::LocalProjection::to_position(const int, const double*, const double*,
+    double*, double*) const;
+%ignore geofun::FileChunk;
+%ignore geofun::FileReader::chunk;
+%ignore geofun::FileReader::read;
+%ignore geofun::FileError;
+/* The line index and the vector queries of PositionIndex are for C++;
+   Python has position_index, polygon, containing and the array queries
+   below */
+%ignore geofun::lon_span;
+%ignore geofun::LineIndex;
+%ignore geofun::Crossing;
+%ignore geofun::crossings;
+%ignore geofun::Neighbour;
+%ignore geofun::PositionIndex::PositionIndex(const std::vector<Position>&);
+%ignore geofun::PositionIndex::PositionIndex(const int, const double*, const double*);
+%ignore geofun::PositionIndex::nearest;
+%ignore geofun::PositionIndex::within;
+%ignore geofun::Polygon::Polygon(const std::vector<Position>&);
+%ignore geofun::Polygon::Polygon(const std::vector<Line>&);
+%ignore geofun::Polygon::Polygon(const int, const double*, const double*);
+%ignore geofun::Polygon::contains(const int, const double*, const double*, char*) const;
+%ignore geofun::containing;
+
+%exception {
+  try {
+    $action
+  } 
+  catch (const geofun::IndexError& e) {
+    SWIG_exception(SWIG_IndexError, e.what());
+  }
+  catch (const geofun::FileError& e) {
+    SWIG_exception(SWIG_IOError, e.what());
+  }
+}
+
+/* MappedFile below validates files with FileReader and views the chunks it
+   found */
+%extend geofun::FileReader {
+  int chunk_count(const int i) const {
+    return $self->chunk(i).count;
+  }
+}
+
+%include "geofun_track.hpp"
+%include "geofun_file.hpp"
+%include "geofun_local.hpp"
+%include "geofun_index.hpp"
+
 %exception;
 
 %exception {
@@ -71,6 +181,766 @@
 
 %exception;
 
+/* Array functions. These take any object that exports a C contiguous float64
+   buffer (numpy arrays in particular) without copying it and write into
+   caller provided output buffers. The GIL is released while computing. */
+%{
+struct ArrayView {
+  ArrayView(): data(0), flags(0), size(0), _acquired(false) {}
+  ~ArrayView() {
+    if (_acquired)
+      PyBuffer_Release(&_view);
+  }
+  bool acquire(PyObject* obj, const bool writable, const char* name) {
+    int flags = PyBUF_C_CONTIGUOUS | PyBUF_FORMAT;
+    if (writable)
+      flags |= PyBUF_WRITABLE;
+    if (PyObject_GetBuffer(obj, &_view, flags) != 0)
+      return false;
+    _acquired = true;
+    if (_view.itemsize != sizeof(double) or _view.format == 0
+        or std::string(_view.format) != "d") {
+      PyErr_Format(PyExc_TypeError, "%s: expected a float64 array", name);
+      return false;
+    }
+    data = static_cast<double*>(_view.buf);
+    size = _view.len / sizeof(double);
+    return true;
+  }
+  // A writable uint8 or bool array of flags
+  bool acquire_flags(PyObject* obj, const char* name) {
+    if (PyObject_GetBuffer(obj, &_view, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT | PyBUF_WRITABLE) != 0)
+      return false;
+    _acquired = true;
+    if (_view.itemsize != 1 or _view.format == 0
+        or (std::string(_view.format) != "B" and std::string(_view.format) != "?")) {
+      PyErr_Format(PyExc_TypeError, "%s: expected a uint8 or bool array", name);
+      return false;
+    }
+    flags = static_cast<char*>(_view.buf);
+    size = _view.len;
+    return true;
+  }
+  double* data;
+  char* flags;
+  Py_ssize_t size;
+private:
+  Py_buffer _view;
+  bool _acquired;
+};
+
+static bool acquire_arrays(ArrayView* views, PyObject** objs, const int n_in,
+    const int n_out, const char** names, Py_ssize_t* size)
+{
+  for (int i = 0; i < n_in + n_out; ++i) {
+    if (not views[i].acquire(objs[i], i >= n_in, names[i]))
+      return false;
+  }
+  *size = views[n_in + n_out - 1].size;
+  for (int i = 0; i < n_in + n_out; ++i) {
+    if (views[i].size != *size) {
+      PyErr_Format(PyExc_ValueError, "%s: size %zd differs from %zd",
+          names[i], views[i].size, *size);
+      return false;
+    }
+  }
+  return true;
+}
+%}
+
+%inline %{
+PyObject* _vincenty_inverse(PyObject* lat1, PyObject* lon1,
+    PyObject* lat2, PyObject* lon2,
+    PyObject* distance, PyObject* azimuth, PyObject* reverse_azimuth)
+{
+  PyObject* objs[] = {lat1, lon1, lat2, lon2, distance, azimuth, reverse_azimuth};
+  const char* names[] = {"lat1", "lon1", "lat2", "lon2", "distance", "azimuth", "reverse_azimuth"};
+  ArrayView v[7];
+  Py_ssize_t n;
+  if (not acquire_arrays(v, objs, 4, 3, names, &n))
+    return NULL;
+  Py_BEGIN_ALLOW_THREADS
+  geofun::vincenty_inverse(n, v[0].data, v[1].data, v[2].data, v[3].data,
+      v[4].data, v[5].data, v[6].data);
+  Py_END_ALLOW_THREADS
+  Py_RETURN_NONE;
+}
+
+PyObject* _vincenty_direct(PyObject* lat1, PyObject* lon1,
+    PyObject* azimuth, PyObject* range,
+    PyObject* lat2, PyObject* lon2, PyObject* reverse_azimuth)
+{
+  ArrayView origin[2];
+  if (not origin[0].acquire(lat1, false, "lat1") or not origin[1].acquire(lon1, false, "lon1"))
+    return NULL;
+  if (origin[0].size == 1 and origin[1].size == 1) {
+    // All vectors share a single origin
+    PyObject* objs[] = {azimuth, range, lat2, lon2, reverse_azimuth};
+    const char* names[] = {"azimuth", "range", "lat2", "lon2", "reverse_azimuth"};
+    ArrayView v[5];
+    Py_ssize_t n;
+    if (not acquire_arrays(v, objs, 2, 3, names, &n))
+      return NULL;
+    Py_BEGIN_ALLOW_THREADS
+    geofun::vincenty_direct(origin[0].data[0], origin[1].data[0], n,
+        v[0].data, v[1].data, v[2].data, v[3].data, v[4].data);
+    Py_END_ALLOW_THREADS
+    Py_RETURN_NONE;
+  }
+  PyObject* objs[] = {lat1, lon1, azimuth, range, lat2, lon2, reverse_azimuth};
+  const char* names[] = {"lat1", "lon1", "azimuth", "range", "lat2", "lon2", "reverse_azimuth"};
+  ArrayView v[7];
+  Py_ssize_t n;
+  if (not acquire_arrays(v, objs, 4, 3, names, &n))
+    return NULL;
+  Py_BEGIN_ALLOW_THREADS
+  geofun::vincenty_direct(n, v[0].data, v[1].data, v[2].data, v[3].data,
+      v[4].data, v[5].data, v[6].data);
+  Py_END_ALLOW_THREADS
+  Py_RETURN_NONE;
+}
+
+PyObject* _distance_matrix(PyObject* lat1, PyObject* lon1,
+    PyObject* lat2, PyObject* lon2,
+    PyObject* distance, PyObject* azimuth, PyObject* reverse_azimuth)
+{
+  ArrayView p1[2], p2[2], out[3];
+  if (not p1[0].acquire(lat1, false, "lat1") or not p1[1].acquire(lon1, false, "lon1"))
+    return NULL;
+  const bool symmetric = lat2 == Py_None;
+  if (not symmetric and (not p2[0].acquire(lat2, false, "lat2")
+        or not p2[1].acquire(lon2, false, "lon2")))
+    return NULL;
+  Py_ssize_t n = p1[0].size;
+  Py_ssize_t m = symmetric ? n : p2[0].size;
+  if (p1[1].size != n or p2[1].size != (symmetric ? 0 : m)) {
+    PyErr_SetString(PyExc_ValueError, "latitude and longitude sizes differ");
+    return NULL;
+  }
+  PyObject* objs[] = {distance, azimuth, reverse_azimuth};
+  const char* names[] = {"distance", "azimuth", "reverse_azimuth"};
+  for (int i = 0; i < 3; ++i) {
+    if (objs[i] == Py_None)
+      continue;
+    if (not out[i].acquire(objs[i], true, names[i]))
+      return NULL;
+    if (out[i].size != n * m) {
+      PyErr_Format(PyExc_ValueError, "%s: size %zd differs from %zd",
+          names[i], out[i].size, n * m);
+      return NULL;
+    }
+  }
+  if (out[0].data == 0) {
+    PyErr_SetString(PyExc_ValueError, "distance: output required");
+    return NULL;
+  }
+  Py_BEGIN_ALLOW_THREADS
+  if (symmetric)
+    geofun::distance_matrix(n, p1[0].data, p1[1].data,
+        out[0].data, out[1].data, out[2].data);
+  else
+    geofun::distance_matrix(n, p1[0].data, p1[1].data, m, p2[0].data, p2[1].data,
+        out[0].data, out[1].data, out[2].data);
+  Py_END_ALLOW_THREADS
+  Py_RETURN_NONE;
+}
+
+PyObject* _rhumb_inverse(PyObject* lat1, PyObject* lon1,
+    PyObject* lat2, PyObject* lon2, PyObject* azimuth, PyObject* range)
+{
+  PyObject* objs[] = {lat1, lon1, lat2, lon2, azimuth, range};
+  const char* names[] = {"lat1", "lon1", "lat2", "lon2", "azimuth", "range"};
+  ArrayView v[6];
+  Py_ssize_t n;
+  if (not acquire_arrays(v, objs, 4, 2, names, &n))
+    return NULL;
+  Py_BEGIN_ALLOW_THREADS
+  geofun::rhumb_inverse(n, v[0].data, v[1].data, v[2].data, v[3].data,
+      v[4].data, v[5].data);
+  Py_END_ALLOW_THREADS
+  Py_RETURN_NONE;
+}
+
+PyObject* _rhumb_direct(PyObject* lat1, PyObject* lon1,
+    PyObject* azimuth, PyObject* range, PyObject* lat2, PyObject* lon2)
+{
+  PyObject* objs[] = {lat1, lon1, azimuth, range, lat2, lon2};
+  const char* names[] = {"lat1", "lon1", "azimuth", "range", "lat2", "lon2"};
+  ArrayView v[6];
+  Py_ssize_t n;
+  if (not acquire_arrays(v, objs, 4, 2, names, &n))
+    return NULL;
+  Py_BEGIN_ALLOW_THREADS
+  geofun::rhumb_direct(n, v[0].data, v[1].data, v[2].data, v[3].data,
+      v[4].data, v[5].data);
+  Py_END_ALLOW_THREADS
+  Py_RETURN_NONE;
+}
+
+PyObject* _rhumb_intersection(PyObject* lat1, PyObject* lon1,
+    PyObject* lat2, PyObject* lon2, PyObject* lat3, PyObject* lon3,
+    PyObject* lat4, PyObject* lon4, PyObject* lat, PyObject* lon)
+{
+  PyObject* objs[] = {lat1, lon1, lat2, lon2, lat3, lon3, lat4, lon4, lat, lon};
+  const char* names[] = {"lat1", "lon1", "lat2", "lon2", "lat3", "lon3", "lat4", "lon4",
+      "lat", "lon"};
+  ArrayView v[10];
+  Py_ssize_t n;
+  if (not acquire_arrays(v, objs, 8, 2, names, &n))
+    return NULL;
+  Py_BEGIN_ALLOW_THREADS
+  geofun::rhumb_intersection(n, v[0].data, v[1].data, v[2].data, v[3].data,
+      v[4].data, v[5].data, v[6].data, v[7].data, v[8].data, v[9].data);
+  Py_END_ALLOW_THREADS
+  Py_RETURN_NONE;
+}
+
+PyObject* _nvector(PyObject* lat, PyObject* lon, PyObject* x, PyObject* y, PyObject* z)
+{
+  PyObject* objs[] = {lat, lon, x, y, z};
+  const char* names[] = {"lat", "lon", "x", "y", "z"};
+  ArrayView v[5];
+  Py_ssize_t n;
+  if (not acquire_arrays(v, objs, 2, 3, names, &n))
+    return NULL;
+  Py_BEGIN_ALLOW_THREADS
+  geofun::nvector(n, v[0].data, v[1].data, v[2].data, v[3].data, v[4].data);
+  Py_END_ALLOW_THREADS
+  Py_RETURN_NONE;
+}
+
+PyObject* _nvector_position(PyObject* x, PyObject* y, PyObject* z,
+    PyObject* lat, PyObject* lon)
+{
+  PyObject* objs[] = {x, y, z, lat, lon};
+  const char* names[] = {"x", "y", "z", "lat", "lon"};
+  ArrayView v[5];
+  Py_ssize_t n;
+  if (not acquire_arrays(v, objs, 3, 2, names, &n))
+    return NULL;
+  Py_BEGIN_ALLOW_THREADS
+  geofun::nvector_position(n, v[0].data, v[1].data, v[2].data, v[3].data, v[4].data);
+  Py_END_ALLOW_THREADS
+  Py_RETURN_NONE;
+}
+
+PyObject* _ecef(PyObject* lat, PyObject* lon, PyObject* x, PyObject* y, PyObject* z)
+{
+  PyObject* objs[] = {lat, lon, x, y, z};
+  const char* names[] = {"lat", "lon", "x", "y", "z"};
+  ArrayView v[5];
+  Py_ssize_t n;
+  if (not acquire_arrays(v, objs, 2, 3, names, &n))
+    return NULL;
+  const geofun::Ellipsoid& e = geofun::get_earth_model()->get_ellipsoid();
+  Py_BEGIN_ALLOW_THREADS
+  geofun::ecef(n, v[0].data, v[1].data, v[2].data, v[3].data, v[4].data, e);
+  Py_END_ALLOW_THREADS
+  Py_RETURN_NONE;
+}
+
+PyObject* _ecef_position(PyObject* x, PyObject* y, PyObject* z,
+    PyObject* lat, PyObject* lon, PyObject* height)
+{
+  PyObject* objs[] = {x, y, z, lat, lon, height};
+  const char* names[] = {"x", "y", "z", "lat", "lon", "height"};
+  ArrayView v[6];
+  Py_ssize_t n;
+  if (not acquire_arrays(v, objs, 3, 3, names, &n))
+    return NULL;
+  const geofun::Ellipsoid& e = geofun::get_earth_model()->get_ellipsoid();
+  Py_BEGIN_ALLOW_THREADS
+  geofun::ecef_position(n, v[0].data, v[1].data, v[2].data, v[3].data, v[4].data,
+      v[5].data, e);
+  Py_END_ALLOW_THREADS
+  Py_RETURN_NONE;
+}
+
+PyObject* _local_to_coord(const geofun::LocalProjection* projection,
+    PyObject* lat, PyObject* lon, PyObject* x, PyObject* y)
+{
+  PyObject* objs[] = {lat, lon, x, y};
+  const char* names[] = {"lat", "lon", "x", "y"};
+  ArrayView v[4];
+  Py_ssize_t n;
+  if (not acquire_arrays(v, objs, 2, 2, names, &n))
+    return NULL;
+  Py_BEGIN_ALLOW_THREADS
+  projection->to_coord(n, v[0].data, v[1].data, v[2].data, v[3].data);
+  Py_END_ALLOW_THREADS
+  Py_RETURN_NONE;
+}
+
+PyObject* _local_to_position(const geofun::LocalProjection* projection,
+    PyObject* x, PyObject* y, PyObject* lat, PyObject* lon)
+{
+  PyObject* objs[] = {x, y, lat, lon};
+  const char* names[] = {"x", "y", "lat", "lon"};
+  ArrayView v[4];
+  Py_ssize_t n;
+  if (not acquire_arrays(v, objs, 2, 2, names, &n))
+    return NULL;
+  Py_BEGIN_ALLOW_THREADS
+  projection->to_position(n, v[0].data, v[1].data, v[2].data, v[3].data);
+  Py_END_ALLOW_THREADS
+  Py_RETURN_NONE;
+}
+
+PyObject* _track_offsets_arrays(const geofun::Track* track, PyObject* lat, PyObject* lon,
+    PyObject* leg, PyObject* cross_track, PyObject* along_track)
+{
+  PyObject* objs[] = {lat, lon, leg, cross_track, along_track};
+  const char* names[] = {"lat", "lon", "leg", "cross_track", "along_track"};
+  ArrayView v[5];
+  Py_ssize_t n;
+  if (not acquire_arrays(v, objs, 2, 3, names, &n))
+    return NULL;
+  if (track->size() < 2) {
+    PyErr_SetString(PyExc_IndexError, "track has no legs");
+    return NULL;
+  }
+  Py_BEGIN_ALLOW_THREADS
+  // The legs are returned as floats like the other outputs
+  std::vector<int> legs(n);
+  track->offsets(n, v[0].data, v[1].data, legs.data(), v[3].data, v[4].data);
+  std::copy(legs.begin(), legs.end(), v[2].data);
+  Py_END_ALLOW_THREADS
+  Py_RETURN_NONE;
+}
+
+PyObject* _file_write(geofun::FileWriter* writer, PyObject* column0, PyObject* column1,
+    PyObject* column2, PyObject* column3)
+{
+  PyObject* objs[] = {column0, column1, column2, column3};
+  const char* names[] = {"column0", "column1", "column2", "column3"};
+  int m = 2;
+  while (m < 4 and objs[m] != Py_None)
+    ++m;
+  ArrayView v[4];
+  Py_ssize_t n;
+  if (not acquire_arrays(v, objs, m, 0, names, &n))
+    return NULL;
+  std::string error;
+  Py_BEGIN_ALLOW_THREADS
+  try {
+    writer->write(n, v[0].data, v[1].data, v[2].data, v[3].data);
+  }
+  catch (const geofun::FileError& e) {
+    error = e.what();
+  }
+  Py_END_ALLOW_THREADS
+  if (not error.empty()) {
+    PyErr_SetString(PyExc_IOError, error.c_str());
+    return NULL;
+  }
+  Py_RETURN_NONE;
+}
+
+static std::vector<geofun::Position> array_positions(const Py_ssize_t n,
+    const double* lat, const double* lon)
+{
+  std::vector<geofun::Position> positions;
+  positions.reserve(n);
+  for (Py_ssize_t i = 0; i < n; ++i) {
+    geofun::PositionValue p = {lat[i], lon[i]};
+    positions.push_back(geofun::Position(p));
+  }
+  return positions;
+}
+
+PyObject* _position_index(PyObject* lat, PyObject* lon)
+{
+  PyObject* objs[] = {lat, lon};
+  const char* names[] = {"lat", "lon"};
+  ArrayView v[2];
+  Py_ssize_t n;
+  if (not acquire_arrays(v, objs, 2, 0, names, &n))
+    return NULL;
+  geofun::PositionIndex* index;
+  Py_BEGIN_ALLOW_THREADS
+  index = new geofun::PositionIndex(n, v[0].data, v[1].data);
+  Py_END_ALLOW_THREADS
+  return SWIG_NewPointerObj(index, SWIGTYPE_p_geofun__PositionIndex, SWIG_POINTER_OWN);
+}
+
+PyObject* _position_nearest(const geofun::PositionIndex* index, PyObject* lat, PyObject* lon,
+    const int k, const int distance, PyObject* found, PyObject* found_distance)
+{
+  PyObject* objs[] = {lat, lon, found, found_distance};
+  const char* names[] = {"lat", "lon", "index", "distance"};
+  ArrayView v[4];
+  for (int i = 0; i < 4; ++i) {
+    if (not v[i].acquire(objs[i], i >= 2, names[i]))
+      return NULL;
+  }
+  const Py_ssize_t n = v[0].size;
+  for (int i = 1; i < 4; ++i) {
+    const Py_ssize_t size = i < 2 ? n : n * k;
+    if (v[i].size != size) {
+      PyErr_Format(PyExc_ValueError, "%s: size %zd differs from %zd",
+          names[i], v[i].size, size);
+      return NULL;
+    }
+  }
+  Py_BEGIN_ALLOW_THREADS
+  // Row i holds the neighbours of position i, padded with -1 and infinity
+  // when the index holds fewer than k positions
+  std::vector<std::vector<geofun::Neighbour> > result = index->nearest(
+      array_positions(n, v[0].data, v[1].data), k, geofun::PositionDistance(distance));
+  for (Py_ssize_t i = 0; i < n; ++i) {
+    for (int j = 0; j < k; ++j) {
+      const bool some = j < static_cast<int>(result[i].size());
+      v[2].data[i * k + j] = some ? result[i][j].index : -1;
+      v[3].data[i * k + j] = some ? result[i][j].distance : std::numeric_limits<double>::infinity();
+    }
+  }
+  Py_END_ALLOW_THREADS
+  Py_RETURN_NONE;
+}
+
+PyObject* _position_within(const geofun::PositionIndex* index, PyObject* lat, PyObject* lon,
+    const double radius, const int distance)
+{
+  PyObject* objs[] = {lat, lon};
+  const char* names[] = {"lat", "lon"};
+  ArrayView v[2];
+  Py_ssize_t n;
+  if (not acquire_arrays(v, objs, 2, 0, names, &n))
+    return NULL;
+  // The results are returned flat, as int64 offsets of the neighbours of
+  // each position followed by the int64 indices and float64 distances
+  std::vector<int64_t> offsets(n + 1, 0);
+  std::vector<int64_t> found;
+  std::vector<double> found_distance;
+  Py_BEGIN_ALLOW_THREADS
+  std::vector<std::vector<geofun::Neighbour> > result = index->within(
+      array_positions(n, v[0].data, v[1].data), radius, geofun::PositionDistance(distance));
+  for (Py_ssize_t i = 0; i < n; ++i) {
+    offsets[i + 1] = offsets[i] + result[i].size();
+    for (size_t j = 0; j < result[i].size(); ++j) {
+      found.push_back(result[i][j].index);
+      found_distance.push_back(result[i][j].distance);
+    }
+  }
+  Py_END_ALLOW_THREADS
+  return Py_BuildValue("(NNN)",
+      PyBytes_FromStringAndSize(reinterpret_cast<const char*>(offsets.data()),
+          offsets.size() * sizeof(int64_t)),
+      PyBytes_FromStringAndSize(reinterpret_cast<const char*>(found.data()),
+          found.size() * sizeof(int64_t)),
+      PyBytes_FromStringAndSize(reinterpret_cast<const char*>(found_distance.data()),
+          found_distance.size() * sizeof(double)));
+}
+
+PyObject* _polygon(PyObject* lat, PyObject* lon)
+{
+  PyObject* objs[] = {lat, lon};
+  const char* names[] = {"lat", "lon"};
+  ArrayView v[2];
+  Py_ssize_t n;
+  if (not acquire_arrays(v, objs, 2, 0, names, &n))
+    return NULL;
+  geofun::Polygon* polygon;
+  Py_BEGIN_ALLOW_THREADS
+  polygon = new geofun::Polygon(n, v[0].data, v[1].data);
+  Py_END_ALLOW_THREADS
+  return SWIG_NewPointerObj(polygon, SWIGTYPE_p_geofun__Polygon, SWIG_POINTER_OWN);
+}
+
+PyObject* _containing(PyObject* polygons, PyObject* lat, PyObject* lon, PyObject* inside)
+{
+  PyObject* objs[] = {lat, lon};
+  const char* names[] = {"lat", "lon"};
+  ArrayView v[3];
+  Py_ssize_t n;
+  if (not acquire_arrays(v, objs, 2, 0, names, &n) or not v[2].acquire_flags(inside, "inside"))
+    return NULL;
+  PyObject* items = PySequence_Fast(polygons, "polygons: expected a sequence");
+  if (not items)
+    return NULL;
+  // The polygons are copied, as containing takes them contiguous
+  std::vector<geofun::Polygon> copies;
+  const Py_ssize_t m = PySequence_Fast_GET_SIZE(items);
+  for (Py_ssize_t j = 0; j < m; ++j) {
+    void* polygon;
+    if (not SWIG_IsOK(SWIG_ConvertPtr(PySequence_Fast_GET_ITEM(items, j), &polygon,
+          SWIGTYPE_p_geofun__Polygon, 0))) {
+      Py_DECREF(items);
+      PyErr_SetString(PyExc_TypeError, "polygons: expected Polygon objects");
+      return NULL;
+    }
+    copies.push_back(*static_cast<geofun::Polygon*>(polygon));
+  }
+  Py_DECREF(items);
+  if (v[2].size != n * m) {
+    PyErr_Format(PyExc_ValueError, "inside: size %zd differs from %zd", v[2].size, n * m);
+    return NULL;
+  }
+  Py_BEGIN_ALLOW_THREADS
+  geofun::containing(copies, n, v[0].data, v[1].data, v[2].flags);
+  Py_END_ALLOW_THREADS
+  Py_RETURN_NONE;
+}
+%}
+
+%pythoncode %{
+def _array(values):
+    import numpy
+    return numpy.ascontiguousarray(values, dtype=numpy.float64)
+
+def _output(out, like):
+    if out is None:
+        import numpy
+        return numpy.empty(len(like))
+    return out
+
+def vincenty_inverse(lat1, lon1, lat2, lon2,
+                     distance=None, azimuth=None, reverse_azimuth=None):
+    """Geodesic distance, azimuth and reverse azimuth for arrays of
+    position pairs in radians. Returns (distance, azimuth, reverse_azimuth)"""
+    lat1, lon1, lat2, lon2 = map(_array, (lat1, lon1, lat2, lon2))
+    distance = _output(distance, lat1)
+    azimuth = _output(azimuth, lat1)
+    reverse_azimuth = _output(reverse_azimuth, lat1)
+    _vincenty_inverse(lat1, lon1, lat2, lon2, distance, azimuth, reverse_azimuth)
+    return distance, azimuth, reverse_azimuth
+
+def distance(lat1, lon1, lat2, lon2, out=None):
+    """Geodesic distance for arrays of position pairs in radians"""
+    return vincenty_inverse(lat1, lon1, lat2, lon2, distance=out)[0]
+
+def bearing(lat1, lon1, lat2, lon2, out=None):
+    """Initial geodesic azimuth for arrays of position pairs in radians"""
+    return vincenty_inverse(lat1, lon1, lat2, lon2, azimuth=out)[1]
+
+def vincenty_direct(lat1, lon1, azimuth, range,
+                    lat2=None, lon2=None, reverse_azimuth=None):
+    """End positions and reverse azimuths of geodesics in radians. lat1 and
+    lon1 may hold a single origin shared by all vectors.
+    Returns (lat2, lon2, reverse_azimuth)"""
+    lat1, lon1, azimuth, range = map(_array, (lat1, lon1, azimuth, range))
+    lat2 = _output(lat2, azimuth)
+    lon2 = _output(lon2, azimuth)
+    reverse_azimuth = _output(reverse_azimuth, azimuth)
+    _vincenty_direct(lat1, lon1, azimuth, range, lat2, lon2, reverse_azimuth)
+    return lat2, lon2, reverse_azimuth
+
+def distance_matrix(lat1, lon1, lat2=None, lon2=None, distance=None,
+                    azimuth=None, reverse_azimuth=None, azimuths=False):
+    """Geodesic distances between all positions 1 and all positions 2 in
+    radians as a row major (n, m) array. Without positions 2 the symmetric
+    matrix between positions 1 is computed. With azimuths=True, or when
+    output arrays for them are given, returns (distance, azimuth,
+    reverse_azimuth)"""
+    import numpy
+    lat1, lon1 = _array(lat1), _array(lon1)
+    if lat2 is not None:
+        lat2, lon2 = _array(lat2), _array(lon2)
+    shape = (len(lat1), len(lat1) if lat2 is None else len(lat2))
+    azimuths = azimuths or azimuth is not None or reverse_azimuth is not None
+    if distance is None:
+        distance = numpy.empty(shape)
+    if azimuths and azimuth is None:
+        azimuth = numpy.empty(shape)
+    if azimuths and reverse_azimuth is None:
+        reverse_azimuth = numpy.empty(shape)
+    _distance_matrix(lat1, lon1, lat2, lon2, distance, azimuth, reverse_azimuth)
+    if azimuths:
+        return distance, azimuth, reverse_azimuth
+    return distance
+
+def rhumb_inverse(lat1, lon1, lat2, lon2, azimuth=None, range=None):
+    """Array version of Position - Position in radians: the vectors from
+    positions 1 to positions 2. Returns (azimuth, range)"""
+    lat1, lon1, lat2, lon2 = map(_array, (lat1, lon1, lat2, lon2))
+    azimuth = _output(azimuth, lat1)
+    range = _output(range, lat1)
+    _rhumb_inverse(lat1, lon1, lat2, lon2, azimuth, range)
+    return azimuth, range
+
+def rhumb_direct(lat1, lon1, azimuth, range, lat2=None, lon2=None):
+    """Array version of Position + Vector in radians. Returns (lat2, lon2)"""
+    lat1, lon1, azimuth, range = map(_array, (lat1, lon1, azimuth, range))
+    lat2 = _output(lat2, lat1)
+    lon2 = _output(lon2, lat1)
+    _rhumb_direct(lat1, lon1, azimuth, range, lat2, lon2)
+    return lat2, lon2
+
+def rhumb_intersection(lat1, lon1, lat2, lon2, lat3, lon3, lat4, lon4,
+                       lat=None, lon=None):
+    """Crossings of the rhumb lines from positions 1 to 2 with those from
+    positions 3 to 4 in radians. Returns (lat, lon), NaN where the segments
+    don't cross"""
+    lat1, lon1, lat2, lon2, lat3, lon3, lat4, lon4 = map(_array,
+        (lat1, lon1, lat2, lon2, lat3, lon3, lat4, lon4))
+    lat = _output(lat, lat1)
+    lon = _output(lon, lat1)
+    _rhumb_intersection(lat1, lon1, lat2, lon2, lat3, lon3, lat4, lon4, lat, lon)
+    return lat, lon
+
+def nvector(lat, lon, x=None, y=None, z=None):
+    """Unit normal vectors of positions in radians in earth centered, earth
+    fixed axes. Returns (x, y, z)"""
+    lat, lon = _array(lat), _array(lon)
+    x, y, z = _output(x, lat), _output(y, lat), _output(z, lat)
+    _nvector(lat, lon, x, y, z)
+    return x, y, z
+
+def nvector_position(x, y, z, lat=None, lon=None):
+    """Positions in radians of n-vectors. Returns (lat, lon)"""
+    x, y, z = map(_array, (x, y, z))
+    lat, lon = _output(lat, x), _output(lon, x)
+    _nvector_position(x, y, z, lat, lon)
+    return lat, lon
+
+def ecef(lat, lon, x=None, y=None, z=None):
+    """Earth centered, earth fixed coordinates in meters of positions in
+    radians on the ellipsoid of the earth model. Returns (x, y, z)"""
+    lat, lon = _array(lat), _array(lon)
+    x, y, z = _output(x, lat), _output(y, lat), _output(z, lat)
+    _ecef(lat, lon, x, y, z)
+    return x, y, z
+
+def ecef_position(x, y, z, lat=None, lon=None, height=None):
+    """Positions in radians and heights above the ellipsoid of the earth
+    model of ECEF coordinates. Returns (lat, lon, height)"""
+    x, y, z = map(_array, (x, y, z))
+    lat, lon, height = _output(lat, x), _output(lon, x), _output(height, x)
+    _ecef_position(x, y, z, lat, lon, height)
+    return lat, lon, height
+
+def _local_to_coords(self, lat, lon, x=None, y=None):
+    """Map arrays of positions in radians to meters north and east of the
+    origin. Returns (x, y)"""
+    lat, lon = _array(lat), _array(lon)
+    x, y = _output(x, lat), _output(y, lat)
+    _local_to_coord(self, lat, lon, x, y)
+    return x, y
+
+def _local_to_positions(self, x, y, lat=None, lon=None):
+    """Map arrays of meters north and east of the origin to positions in
+    radians. Returns (lat, lon)"""
+    x, y = _array(x), _array(y)
+    lat, lon = _output(lat, x), _output(lon, x)
+    _local_to_position(self, x, y, lat, lon)
+    return lat, lon
+
+LocalProjection.to_coords = _local_to_coords
+LocalProjection.to_positions = _local_to_positions
+
+def _track_offsets(self, lat, lon, cross_track=None, along_track=None):
+    """Offsets of arrays of positions in radians from the track as a route:
+    the nearest leg, the distance from it, positive to the right, and the
+    distance along the track to its nearest point. Returns (leg,
+    cross_track, along_track)"""
+    import numpy
+    lat, lon = _array(lat), _array(lon)
+    leg = numpy.empty(len(lat))
+    cross_track = _output(cross_track, lat)
+    along_track = _output(along_track, lat)
+    _track_offsets_arrays(self, lat, lon, leg, cross_track, along_track)
+    return leg.astype(int), cross_track, along_track
+
+Track.offsets = _track_offsets
+
+def _file_write_arrays(self, *columns):
+    """Append records given as one array per column, in radians and
+    seconds"""
+    columns = list(map(_array, columns)) + [None] * (4 - len(columns))
+    _file_write(self, *columns)
+
+FileWriter.write_arrays = _file_write_arrays
+
+def position_index(lat, lon):
+    """PositionIndex of arrays of positions in radians"""
+    return _position_index(_array(lat), _array(lon))
+
+def _index_nearest(self, lat, lon, k, distance=pd_geodesic):
+    """The k indexed positions nearest to each of arrays of positions in
+    radians, ordered by distance, by geodesic or, with pd_rhumb, rhumb line
+    distance. Returns (index, distance) as (n, k) arrays, with k limited to
+    the size of the index"""
+    import numpy
+    lat, lon = _array(lat), _array(lon)
+    k = max(0, min(k, len(self)))
+    found = numpy.empty((len(lat), k))
+    found_distance = numpy.empty((len(lat), k))
+    _position_nearest(self, lat, lon, k, distance, found, found_distance)
+    return found.astype(int), found_distance
+
+def _index_within(self, lat, lon, radius, distance=pd_geodesic):
+    """The indexed positions within radius meters of each of arrays of
+    positions in radians, ordered by distance. Returns (offsets, index,
+    distance): the neighbours of position i are index[offsets[i]:offsets[i
+    + 1]] at distance[offsets[i]:offsets[i + 1]]"""
+    import numpy
+    lat, lon = _array(lat), _array(lon)
+    offsets, found, found_distance = _position_within(self, lat, lon, radius, distance)
+    return (numpy.frombuffer(offsets, numpy.int64), numpy.frombuffer(found, numpy.int64),
+            numpy.frombuffer(found_distance, numpy.float64))
+
+PositionIndex.nearest = _index_nearest
+PositionIndex.within = _index_within
+
+def polygon(lat, lon):
+    """Polygon of arrays of vertices in radians"""
+    return _polygon(_array(lat), _array(lon))
+
+def containing(polygons, lat, lon, inside=None):
+    """Containment of arrays of positions in radians in a sequence of
+    polygons as a row major (n, m) bool array: inside[i, j] is whether
+    position i lies in polygon j. inside may also be a uint8 array"""
+    import numpy
+    lat, lon = _array(lat), _array(lon)
+    polygons = list(polygons)
+    if inside is None:
+        inside = numpy.empty((len(lat), len(polygons)), dtype=bool)
+    _containing(polygons, lat, lon, inside)
+    return inside
+
+import math as _math
+_angle_quantum = _math.pi / 2147483648.0
+
+class MappedFile(object):
+    """Memory mapped geofun file. chunks holds a tuple of arrays per chunk,
+    one per column, that view the mapping without copying it. Those of a
+    float64 file can be passed to the array functions as they are; int32
+    files hold quantized angles. column(i) returns a column of all chunks
+    in radians or seconds. Files that FileReader rejects raise IOError."""
+    def __init__(self, path):
+        import mmap, numpy
+        reader = FileReader(path)
+        self.kind, self.encoding = reader.get_kind(), reader.get_encoding()
+        with open(path, 'rb') as f:
+            self._map = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+        f8, i4 = numpy.dtype('<f8'), numpy.dtype('<i4')
+        self._columns = file_columns(self.kind)
+        self.chunks = []
+        for c in range(reader.chunks()):
+            count = reader.chunk_count(c)
+            chunk = []
+            for i in range(self._columns):
+                time = self.kind == fk_track and i == 2
+                dtype = f8 if time or self.encoding == fe_float64 else i4
+                chunk.append(numpy.frombuffer(self._map, dtype, count,
+                                              reader.column_offset(c, i)))
+            self.chunks.append(tuple(chunk))
+
+    def __len__(self):
+        return sum(len(chunk[0]) for chunk in self.chunks)
+
+    def column(self, i):
+        import numpy
+        if i < 0 or i >= self._columns:
+            raise IndexError(i)
+        if not self.chunks:
+            return numpy.empty(0)
+        values = numpy.concatenate([chunk[i] for chunk in self.chunks])
+        if values.dtype != numpy.float64:
+            values = values * _angle_quantum
+        return values
+%}
+
 // Add __repr__ and __str__ methods
 
 %extend geofun::Coord {
@@ -0,0 +1,713 @@
+#include "geofun_batch.hpp"
+#include "geofun_pool.hpp"
+
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace geofun {
+
+// Rows and columns per tile of a distance matrix
+static const int matrix_tile = 64;
+
+// Whether any lane is still active. Lane masks are doubles, 1 or 0, so that
+// they have the width of the lane data in the vectorized loops.
+static inline bool any(const double* active)
+{
+  double result = 0;
+  for (int j = 0; j < batch_lanes; ++j) {
+    result += active[j];
+  }
+  return result > 0;
+}
+
+// Solve a block of batch_lanes inverse problems given the sines and cosines
+// of the reduced latitudes and the longitude differences. The first m
+// results are written to the output; the azimuth and status outputs may be
+// 0. Lanes that don't converge are solved with the scalar fallback.
+template <class Math>
+static void inverse_block(const int m,
+    const double* sinu1, const double* cosu1,
+    const double* sinu2, const double* cosu2, const double* dlinit,
+    double* distance, double* azimuth, double* reverse_azimuth,
+    VincentyStatus* status, const Ellipsoid& e)
+{
+  const int L = batch_lanes;
+  const double f = e.f;
+  const double tolerance = get_vincenty_tolerance();
+
+  double sinu1sinu2[L], cosu1cosu2[L], cosu1sinu2[L], sinu1cosu2[L];
+  for (int j = 0; j < L; ++j) {
+    sinu1sinu2[j] = sinu1[j] * sinu2[j];
+    cosu1cosu2[j] = cosu1[j] * cosu2[j];
+    cosu1sinu2[j] = cosu1[j] * sinu2[j];
+    sinu1cosu2[j] = sinu1[j] * cosu2[j];
+  }
+
+  double dl[L], cosdl[L], sindl[L];
+  double sig[L], sins[L];
+  double sqcosa[L];
+  double cos2sm[L], sqcos2sm[L], coss2sqcos2smm1[L];
+  double active[L];
+  for (int j = 0; j < L; ++j) {
+    dl[j] = dlinit[j];
+    active[j] = 1;
+  }
+
+  // Lanes that have converged stop advancing dl, so that every further
+  // iteration recomputes the state of their final iteration, just like the
+  // scalar loop in Arc::vincenty_inverse leaves it. The state is stored
+  // unconditionally, which keeps the loop free of branches.
+  for (int iteration = 0; iteration < vincenty_max_iterations and any(active); ++iteration) {
+    for (int j = 0; j < L; ++j) {
+      double s_dl, c_dl;
+      Math::sin_cos(dl[j], &s_dl, &c_dl);
+      double s_s = sqrt(sqr(cosu2[j] * s_dl) + sqr(cosu1sinu2[j] - sinu1cosu2[j] * c_dl));
+      double c_s = sinu1sinu2[j] + cosu1cosu2[j] * c_dl;
+      double s = Math::atan2(s_s, c_s);
+      double s_a = cosu1cosu2[j] * s_dl / s_s;
+      double sqc_a = 1 - sqr(s_a);
+      double c_2sm = c_s - 2 * sinu1sinu2[j] / sqc_a;
+      double c = f / 16 * sqc_a * (4 + f * (4 - 3 * sqc_a));
+      double sqc_2sm = sqr(c_2sm);
+      double c_s2sqc_2smm1 = c_s * (2 * sqc_2sm - 1);
+      double dl_next = dlinit[j] + (1 - c) * f * s_a * (s + c * s_s * (c_2sm + c * c_s2sqc_2smm1));
+
+      cosdl[j] = c_dl;
+      sindl[j] = s_dl;
+      sins[j] = s_s;
+      sig[j] = s;
+      sqcosa[j] = sqc_a;
+      cos2sm[j] = c_2sm;
+      sqcos2sm[j] = sqc_2sm;
+      coss2sqcos2smm1[j] = c_s2sqc_2smm1;
+      const bool a = active[j] != 0 and fabs(dl_next - dl[j]) > tolerance;
+      active[j] = a ? 1 : 0;
+      dl[j] = a ? dl_next : dl[j];
+    }
+  }
+
+  // The closing terms run over all lanes, which keeps the loops vectorized,
+  // and only the first m are copied out. The azimuths of atan2 in [-pi, pi]
+  // are wrapped with selects, as angle_2pi would.
+  double result[L];
+  for (int j = 0; j < L; ++j) {
+    double squ = sqcosa[j] * e.ep2;
+    double sqrtsqup1 = sqrt(1 + squ);
+    double k1 = (sqrtsqup1 - 1) / (sqrtsqup1 + 1);
+    double aa = (1 + 0.25 * sqr(k1)) / (1 - k1);
+    double bb = k1 * (1 - (3.0 / 8) * sqr(k1));
+    double dsig = bb * sins[j] * (cos2sm[j] + 0.25 * bb * (coss2sqcos2smm1[j] -
+        (1.0 / 6) * bb * cos2sm[j] * (-3 + 4 * sqr(sins[j])) * (-3 + 4 * sqcos2sm[j])));
+    result[j] = e.b * aa * (sig[j] - dsig);
+  }
+  std::copy(result, result + m, distance);
+  if (azimuth) {
+    for (int j = 0; j < L; ++j) {
+      double a1 = Math::atan2(cosu2[j] * sindl[j], cosu1sinu2[j] - sinu1cosu2[j] * cosdl[j]);
+      result[j] = a1 < 0 ? a1 + two_pi : a1;
+    }
+    std::copy(result, result + m, azimuth);
+  }
+  if (reverse_azimuth) {
+    for (int j = 0; j < L; ++j) {
+      double a2 = pi - Math::atan2(cosu1[j] * sindl[j], -sinu1cosu2[j] + cosu1sinu2[j] * cosdl[j]);
+      result[j] = a2 >= two_pi ? a2 - two_pi : a2;
+    }
+    std::copy(result, result + m, reverse_azimuth);
+  }
+  // Capped lanes, and coincident or antipodal pairs that yield NaN
+  for (int j = 0; j < m; ++j) {
+    const bool failed = active[j] or std::isnan(distance[j]);
+    if (status) {
+      status[j] = failed ? vs_fallback : vs_converged;
+    }
+    if (failed) {
+      double a1, a2;
+      vincenty_inverse_fallback(sinu1[j], cosu1[j], sinu2[j], cosu2[j], dlinit[j], e,
+          &distance[j], &a1, &a2);
+      if (azimuth) {
+        azimuth[j] = a1;
+      }
+      if (reverse_azimuth) {
+        reverse_azimuth[j] = angle_2pi(pi - a2);
+      }
+    }
+  }
+}
+
+static void vincenty_inverse_block(const int m,
+    const double* sinu1, const double* cosu1,
+    const double* sinu2, const double* cosu2, const double* dlinit,
+    double* distance, double* azimuth, double* reverse_azimuth,
+    VincentyStatus* status, const Ellipsoid& e)
+{
+  if (get_math_precision() == mp_fast) {
+    inverse_block<FastMath>(m, sinu1, cosu1, sinu2, cosu2, dlinit,
+        distance, azimuth, reverse_azimuth, status, e);
+  }
+  else {
+    inverse_block<ExactMath>(m, sinu1, cosu1, sinu2, cosu2, dlinit,
+        distance, azimuth, reverse_azimuth, status, e);
+  }
+}
+
+// Angles in radians from any of the storage types of the kernels
+static inline double radians(const double angle)
+{
+  return angle;
+}
+
+static inline double radians(const float angle)
+{
+  return angle;
+}
+
+static inline double radians(const int32_t angle)
+{
+  return angle * angle_quantum;
+}
+
+template <class T>
+static void inverse_arrays(const int n,
+    const T* lat1, const T* lon1, const T* lat2, const T* lon2,
+    double* distance, double* azimuth, double* reverse_azimuth,
+    VincentyStatus* status, const Ellipsoid& e)
+{
+  const int L = batch_lanes;
+  double sinu1[L], cosu1[L], sinu2[L], cosu2[L];
+  double dlinit[L];
+  for (int i = 0; i < n; i += L) {
+    const int m = std::min(L, n - i);
+    for (int j = 0; j < L; ++j) {
+      // Pad the tail of the last block with copies of its first pair
+      int k = i + (j < m ? j : 0);
+      e.reduced_sincos(radians(lat1[k]), &sinu1[j], &cosu1[j]);
+      e.reduced_sincos(radians(lat2[k]), &sinu2[j], &cosu2[j]);
+      dlinit[j] = radians(lon2[k]) - radians(lon1[k]);
+    }
+    vincenty_inverse_block(m, sinu1, cosu1, sinu2, cosu2, dlinit,
+        distance + i, azimuth ? azimuth + i : 0, reverse_azimuth ? reverse_azimuth + i : 0,
+        status ? status + i : 0, e);
+  }
+}
+
+void vincenty_inverse(const int n,
+    const double* lat1, const double* lon1,
+    const double* lat2, const double* lon2,
+    double* distance, double* azimuth, double* reverse_azimuth,
+    VincentyStatus* status, const Ellipsoid& e)
+{
+  inverse_arrays(n, lat1, lon1, lat2, lon2, distance, azimuth, reverse_azimuth, status, e);
+}
+
+void vincenty_inverse(const int n,
+    const int32_t* lat1, const int32_t* lon1,
+    const int32_t* lat2, const int32_t* lon2,
+    double* distance, double* azimuth, double* reverse_azimuth,
+    VincentyStatus* status, const Ellipsoid& e)
+{
+  inverse_arrays(n, lat1, lon1, lat2, lon2, distance, azimuth, reverse_azimuth, status, e);
+}
+
+void vincenty_inverse(const int n,
+    const float* lat1, const float* lon1,
+    const float* lat2, const float* lon2,
+    double* distance, double* azimuth, double* reverse_azimuth,
+    VincentyStatus* status, const Ellipsoid& e)
+{
+  inverse_arrays(n, lat1, lon1, lat2, lon2, distance, azimuth, reverse_azimuth, status, e);
+}
+
+// Per point terms reused by every pair a point takes part in
+struct MatrixPoints {
+  MatrixPoints(const int n, const double* lat, const double* lon, const Ellipsoid& e):
+    sinu(n), cosu(n), lon(lon, lon + n) {
+    for (int i = 0; i < n; ++i) {
+      e.reduced_sincos(lat[i], &sinu[i], &cosu[i]);
+    }
+  }
+  std::vector<double> sinu;
+  std::vector<double> cosu;
+  std::vector<double> lon;
+};
+
+// Solve row i of a matrix tile for columns [begin, end), writing to the
+// row major outputs with m columns. Optionally the results are mirrored to
+// the transposed positions for symmetric matrices.
+static void matrix_row(const MatrixPoints& p1, const MatrixPoints& p2,
+    const int i, const int begin, const int end, const int m,
+    double* distance, double* azimuth, double* reverse_azimuth,
+    const bool mirror, const Ellipsoid& e)
+{
+  const int L = batch_lanes;
+  double sinu1[L], cosu1[L], sinu2[L], cosu2[L], dlinit[L];
+  double d[L], a[L], r[L];
+  const bool azimuths = azimuth or reverse_azimuth;
+  for (int j = 0; j < L; ++j) {
+    sinu1[j] = p1.sinu[i];
+    cosu1[j] = p1.cosu[i];
+  }
+  for (int c = begin; c < end; c += L) {
+    const int k = std::min(L, end - c);
+    for (int j = 0; j < L; ++j) {
+      int col = c + (j < k ? j : 0);
+      sinu2[j] = p2.sinu[col];
+      cosu2[j] = p2.cosu[col];
+      dlinit[j] = p2.lon[col] - p1.lon[i];
+    }
+    const size_t row = size_t(i) * m + c;
+    if (not mirror) {
+      vincenty_inverse_block(k, sinu1, cosu1, sinu2, cosu2, dlinit,
+          distance + row, azimuth ? azimuth + row : 0,
+          reverse_azimuth ? reverse_azimuth + row : 0, 0, e);
+      continue;
+    }
+    vincenty_inverse_block(k, sinu1, cosu1, sinu2, cosu2, dlinit,
+        d, azimuths ? a : 0, azimuths ? r : 0, 0, e);
+    for (int j = 0; j < k; ++j) {
+      // The reverse azimuth is stored as pi minus the arrival azimuth (see
+      // Arc), so the azimuths of the transposed pair are the negated ones
+      const size_t t = size_t(c + j) * m + i;
+      distance[row + j] = d[j];
+      distance[t] = d[j];
+      if (azimuth) {
+        azimuth[row + j] = a[j];
+        azimuth[t] = angle_2pi(-r[j]);
+      }
+      if (reverse_azimuth) {
+        reverse_azimuth[row + j] = r[j];
+        reverse_azimuth[t] = angle_2pi(-a[j]);
+      }
+    }
+  }
+}
+
+void distance_matrix(const int n, const double* lat1, const double* lon1,
+    const int m, const double* lat2, const double* lon2,
+    double* distance, double* azimuth, double* reverse_azimuth,
+    const Ellipsoid& e)
+{
+  const int T = matrix_tile;
+  MatrixPoints p1(n, lat1, lon1, e);
+  MatrixPoints p2(m, lat2, lon2, e);
+  const int cols = (m + T - 1) / T;
+  const int tiles = ((n + T - 1) / T) * cols;
+  ThreadPool::instance().run(tiles, [&](const int tile) {
+    const int r0 = (tile / cols) * T;
+    const int c0 = (tile % cols) * T;
+    for (int i = r0; i < std::min(r0 + T, n); ++i) {
+      matrix_row(p1, p2, i, c0, std::min(c0 + T, m), m,
+          distance, azimuth, reverse_azimuth, false, e);
+    }
+  });
+}
+
+void distance_matrix(const int n, const double* lat, const double* lon,
+    double* distance, double* azimuth, double* reverse_azimuth,
+    const Ellipsoid& e)
+{
+  const int T = matrix_tile;
+  MatrixPoints p(n, lat, lon, e);
+  // Tiles on and above the diagonal only
+  const int blocks = (n + T - 1) / T;
+  std::vector<std::pair<int, int> > tiles;
+  for (int r = 0; r < blocks; ++r) {
+    for (int c = r; c < blocks; ++c) {
+      tiles.push_back(std::make_pair(r, c));
+    }
+  }
+  ThreadPool::instance().run(static_cast<int>(tiles.size()), [&](const int tile) {
+    const int r0 = tiles[tile].first * T;
+    const int c0 = tiles[tile].second * T;
+    for (int i = r0; i < std::min(r0 + T, n); ++i) {
+      const int begin = r0 == c0 ? i + 1 : c0;
+      matrix_row(p, p, i, begin, std::min(c0 + T, n), n,
+          distance, azimuth, reverse_azimuth, true, e);
+    }
+  });
+  for (int i = 0; i < n; ++i) {
+    const size_t d = size_t(i) * n + i;
+    distance[d] = 0;
+    if (azimuth) {
+      azimuth[d] = 0;
+    }
+    if (reverse_azimuth) {
+      reverse_azimuth[d] = 0;
+    }
+  }
+}
+
+void DirectConstants::set_origin(const double lat)
+{
+  ellipsoid.reduced_sincos(lat, &sinu1, &cosu1);
+  tanu1 = sinu1 / cosu1;
+}
+
+void DirectConstants::set_azimuth(const double azimuth)
+{
+  sin_cos(azimuth, &sina1, &cosa1);
+  sig1 = atan2(tanu1, cosa1);
+  sina = cosu1 * sina1;
+  sqcosa = (1 - sina) * (1 + sina);
+  const double f = ellipsoid.f;
+  double squ = sqcosa * ellipsoid.ep2;
+  double sqrtsqup1 = sqrt(1 + squ);
+  k1 = (sqrtsqup1 - 1) / (sqrtsqup1 + 1);
+  aa = (1 + 0.25 * sqr(k1)) / (1 - k1);
+  bb = k1 * (1 - (3.0 / 8) * sqr(k1));
+  c = f / 16 * sqcosa * (4 + f * (4 - 3 * sqcosa));
+}
+
+// Solve a block of batch_lanes direct problems of which the first m are
+// written to the output
+template <class Math>
+static void direct_block(const int m, const DirectConstants* dc,
+    const double* lon1, const double* range,
+    double* lat2, double* lon2, double* reverse_azimuth,
+    VincentyStatus* status, const Ellipsoid& e)
+{
+  const int L = batch_lanes;
+  const double f = e.f;
+  const double tolerance = get_vincenty_tolerance();
+  double siginit[L], sig[L], signext[L], tsig1[L], bb[L];
+  double sins[L], coss[L], cos2sm[L], coss2sqcos2smm1[L];
+  double active[L];
+  for (int j = 0; j < L; ++j) {
+    siginit[j] = range[j] / (e.b * dc[j].aa);
+    sig[j] = siginit[j];
+    tsig1[j] = 2 * dc[j].sig1;
+    bb[j] = dc[j].bb;
+    active[j] = 1;
+  }
+
+  // As in inverse_block, converged lanes stop advancing sig and recompute
+  // the state of their final iteration. Like the scalar loop the solution
+  // takes the sigma of that iteration's update.
+  for (int iteration = 0; iteration < vincenty_max_iterations and any(active); ++iteration) {
+    for (int j = 0; j < L; ++j) {
+      double s_s, c_s;
+      Math::sin_cos(sig[j], &s_s, &c_s);
+      double c_2sm = Math::cos(tsig1[j] + sig[j]);
+      double sqc_2sm = sqr(c_2sm);
+      double c_s2sqc_2smm1 = c_s * (2 * sqc_2sm - 1);
+      double dsig = bb[j] * s_s * (c_2sm + 0.25 * bb[j] * (c_s2sqc_2smm1 -
+          (1.0 / 6) * bb[j] * c_2sm * (-3 + 4 * sqr(s_s)) * (-3 + 4 * sqc_2sm)));
+      double sig_next = siginit[j] + dsig;
+
+      signext[j] = sig_next;
+      sins[j] = s_s;
+      coss[j] = c_s;
+      cos2sm[j] = c_2sm;
+      coss2sqcos2smm1[j] = c_s2sqc_2smm1;
+      const bool a = active[j] != 0 and fabs(sig_next - sig[j]) > tolerance;
+      active[j] = a ? 1 : 0;
+      sig[j] = a ? sig_next : sig[j];
+    }
+  }
+
+  // Closing terms over all lanes, with the constants gathered per lane
+  double sinu1[L], cosu1[L], sina1[L], cosa1[L], sina[L], c[L];
+  for (int j = 0; j < L; ++j) {
+    sinu1[j] = dc[j].sinu1;
+    cosu1[j] = dc[j].cosu1;
+    sina1[j] = dc[j].sina1;
+    cosa1[j] = dc[j].cosa1;
+    sina[j] = dc[j].sina;
+    c[j] = dc[j].c;
+  }
+  double lat[L], dlon[L], az2[L];
+  for (int j = 0; j < L; ++j) {
+    double s1c2 = sinu1[j] * coss[j];
+    double c1s2 = cosu1[j] * sins[j];
+    lat[j] = Math::atan2(s1c2 + c1s2 * cosa1[j],
+        (1 - f) * sqrt(sqr(sina[j]) + sqr(sinu1[j] * sins[j] - cosu1[j] * coss[j] * cosa1[j])));
+    double dl = Math::atan2(sins[j] * sina1[j], cosu1[j] * coss[j] - sinu1[j] * sins[j] * cosa1[j]);
+    dlon[j] = dl - (1 - c[j]) * f * sina[j]
+        * (signext[j] + c[j] * sins[j] * (cos2sm[j] + c[j] * coss2sqcos2smm1[j]));
+    double a2 = pi - Math::atan2(sina[j], -sinu1[j] * sins[j] + cosu1[j] * coss[j] * cosa1[j]);
+    az2[j] = a2 >= two_pi ? a2 - two_pi : a2;
+  }
+  for (int j = 0; j < m; ++j) {
+    lat2[j] = lat[j];
+    lon2[j] = angle_pipi(lon1[j] + dlon[j]);
+    reverse_azimuth[j] = az2[j];
+  }
+  if (status) {
+    for (int j = 0; j < m; ++j) {
+      status[j] = active[j] ? vs_max_iterations : vs_converged;
+    }
+  }
+}
+
+static void vincenty_direct_block(const int m, const DirectConstants* dc,
+    const double* lon1, const double* range,
+    double* lat2, double* lon2, double* reverse_azimuth,
+    VincentyStatus* status, const Ellipsoid& e)
+{
+  if (get_math_precision() == mp_fast) {
+    direct_block<FastMath>(m, dc, lon1, range, lat2, lon2, reverse_azimuth, status, e);
+  }
+  else {
+    direct_block<ExactMath>(m, dc, lon1, range, lat2, lon2, reverse_azimuth, status, e);
+  }
+}
+
+void vincenty_direct(const int n,
+    const double* lat1, const double* lon1,
+    const double* azimuth, const double* range,
+    double* lat2, double* lon2, double* reverse_azimuth,
+    VincentyStatus* status, const Ellipsoid& e)
+{
+  const int L = batch_lanes;
+  DirectConstants dc[L];
+  double lon[L], rng[L];
+  for (int j = 0; j < L; ++j) {
+    dc[j].ellipsoid = e;
+  }
+  for (int i = 0; i < n; i += L) {
+    const int m = std::min(L, n - i);
+    for (int j = 0; j < L; ++j) {
+      int k = i + (j < m ? j : 0);
+      dc[j].set_origin(lat1[k]);
+      dc[j].set_azimuth(azimuth[k]);
+      lon[j] = lon1[k];
+      rng[j] = range[k];
+    }
+    vincenty_direct_block(m, dc, lon, rng, lat2 + i, lon2 + i, reverse_azimuth + i,
+        status ? status + i : 0, e);
+  }
+}
+
+void vincenty_direct(const double lat1, const double lon1, const int n,
+    const double* azimuth, const double* range,
+    double* lat2, double* lon2, double* reverse_azimuth,
+    VincentyStatus* status, const Ellipsoid& e)
+{
+  const int L = batch_lanes;
+  DirectConstants origin(e);
+  origin.set_origin(lat1);
+  DirectConstants dc[L];
+  double lon[L], rng[L];
+  double previous = 0;
+  for (int j = 0; j < L; ++j) {
+    dc[j] = origin;
+    lon[j] = lon1;
+  }
+  for (int i = 0; i < n; i += L) {
+    const int m = std::min(L, n - i);
+    for (int j = 0; j < L; ++j) {
+      int k = i + (j < m ? j : 0);
+      if (k == 0 or azimuth[k] != previous) {
+        origin.set_azimuth(azimuth[k]);
+        previous = azimuth[k];
+      }
+      dc[j] = origin;
+      rng[j] = range[k];
+    }
+    vincenty_direct_block(m, dc, lon, rng, lat2 + i, lon2 + i, reverse_azimuth + i,
+        status ? status + i : 0, e);
+  }
+}
+
+// Direct problem along the geodesic of dc for one distance
+template <class Math>
+static void line_position(const DirectConstants& d, const double lon1, const double distance,
+    double* lat2, double* lon2, double* azimuth)
+{
+  const Ellipsoid& e = d.ellipsoid;
+  const double f = e.f;
+  const double tolerance = get_vincenty_tolerance();
+  const double siginit = distance / (e.b * d.aa);
+  double sig = siginit;
+  double sigprev, sins, coss, cos2sm, coss2sqcos2smm1;
+  int iterations = 0;
+  do {
+    sigprev = sig;
+    Math::sin_cos(sig, &sins, &coss);
+    cos2sm = Math::cos(2 * d.sig1 + sig);
+    double sqcos2sm = sqr(cos2sm);
+    coss2sqcos2smm1 = coss * (2 * sqcos2sm - 1);
+    double dsig = d.bb * sins * (cos2sm + 0.25 * d.bb * (coss2sqcos2smm1 -
+        (1.0 / 6) * d.bb * cos2sm * (-3 + 4 * sqr(sins)) * (-3 + 4 * sqcos2sm)));
+    sig = siginit + dsig;
+  } while (fabs(sig - sigprev) > tolerance and ++iterations < vincenty_max_iterations);
+
+  *lat2 = Math::atan2(d.sinu1 * coss + d.cosu1 * sins * d.cosa1,
+      (1 - f) * sqrt(sqr(d.sina) + sqr(d.sinu1 * sins - d.cosu1 * coss * d.cosa1)));
+  double dl = Math::atan2(sins * d.sina1, d.cosu1 * coss - d.sinu1 * sins * d.cosa1);
+  *lon2 = angle_pipi(lon1 + dl - (1 - d.c) * f * d.sina
+      * (sig + d.c * sins * (cos2sm + d.c * coss2sqcos2smm1)));
+  if (azimuth) {
+    *azimuth = angle_2pi(Math::atan2(d.sina, -d.sinu1 * sins + d.cosu1 * coss * d.cosa1));
+  }
+}
+
+void GeodesicLine::position(const double distance, double* lat, double* lon,
+    double* azimuth) const
+{
+  if (get_math_precision() == mp_fast) {
+    line_position<FastMath>(_constants, _lon1, distance, lat, lon, azimuth);
+  }
+  else {
+    line_position<ExactMath>(_constants, _lon1, distance, lat, lon, azimuth);
+  }
+}
+
+void GeodesicLine::positions(const int n, const double* distance, double* lat, double* lon,
+    double* azimuth) const
+{
+  const int L = batch_lanes;
+  DirectConstants dc[L];
+  double lon1[L], range[L], reverse_azimuth[L];
+  for (int j = 0; j < L; ++j) {
+    dc[j] = _constants;
+    lon1[j] = _lon1;
+  }
+  for (int i = 0; i < n; i += L) {
+    const int m = std::min(L, n - i);
+    for (int j = 0; j < L; ++j) {
+      range[j] = distance[i + (j < m ? j : 0)];
+    }
+    vincenty_direct_block(m, dc, lon1, range, lat + i, lon + i, reverse_azimuth, 0,
+        _constants.ellipsoid);
+    if (azimuth) {
+      // Reverse azimuths are stored as pi minus the arrival azimuth (see Arc)
+      for (int j = 0; j < m; ++j) {
+        azimuth[i + j] = angle_2pi(pi - reverse_azimuth[j]);
+      }
+    }
+  }
+}
+
+void GeodesicLine::waypoints(const int n, double* lat, double* lon) const
+{
+  std::vector<double> distance(n);
+  for (int i = 0; i < n; ++i) {
+    distance[i] = n > 1 ? _length * i / (n - 1) : 0;
+  }
+  positions(n, distance.data(), lat, lon);
+}
+
+GeodesicLine::Waypoints GeodesicLine::waypoints(const double spacing) const
+{
+  // Every multiple of spacing short of the length, then the end itself
+  int count = 1;
+  double step = spacing;
+  if (_length > 0 and not (spacing > 0)) {
+    count = 2;
+    step = _length;
+  }
+  else if (_length > 0) {
+    // Without a point right before the end when the length is a multiple
+    const double intervals = _length / spacing * (1 - 1E-12);
+    const int limit = std::numeric_limits<int>::max() - 1;
+    if (intervals < limit) {
+      count = static_cast<int>(ceil(intervals)) + 1;
+    }
+    else {
+      count = limit + 1;
+      step = _length / limit;
+    }
+  }
+  Waypoints result = {this, step, count};
+  return result;
+}
+
+// Largest integer not above x, for |x| below 2^51. Adding and subtracting
+// 1.5 * 2^52 rounds to the nearest integer without a call into libm.
+static inline double floor_lanes(const double x)
+{
+  const double shifter = 6755399441055744.0;
+  const double r = (x + shifter) - shifter;
+  return r > x ? r - 1 : r;
+}
+
+// Convert n values. The lanes of full blocks are converted in a loop with a
+// fixed trip count, which vectorizes at -O2 where a loop up to n doesn't;
+// the rest is converted one by one.
+template <class From, class To, class Convert>
+static void convert_lanes(const int n, const From* from, To* to, const Convert& convert)
+{
+  const int L = batch_lanes;
+  int i = 0;
+  for (; i + L <= n; i += L) {
+    for (int j = 0; j < L; ++j) {
+      to[i + j] = convert(from[i + j]);
+    }
+  }
+  for (; i < n; ++i) {
+    to[i] = convert(from[i]);
+  }
+}
+
+void quantize(const int n, const double* angle, int32_t* quantized)
+{
+  convert_lanes(n, angle, quantized, [](const double a) {
+    // 2^32 steps make a full turn, so the angle wraps by whole turns into
+    // the int32 range and then converts to int32 directly, which vectorizes
+    // where a pass through int64 doesn't
+    const double q = floor_lanes(a / angle_quantum + 0.5);
+    const double turns = floor_lanes((q + 2147483648.0) * (1 / 4294967296.0));
+    return static_cast<int32_t>(q - turns * 4294967296.0);
+  });
+}
+
+void dequantize(const int n, const int32_t* quantized, double* angle)
+{
+  convert_lanes(n, quantized, angle, [](const int32_t q) {
+    return q * angle_quantum;
+  });
+}
+
+void quantize(const int n, const double* angle, float* quantized)
+{
+  convert_lanes(n, angle, quantized, [](const double a) {
+    return static_cast<float>(a);
+  });
+}
+
+void dequantize(const int n, const float* quantized, double* angle)
+{
+  convert_lanes(n, quantized, angle, [](const float q) {
+    return static_cast<double>(q);
+  });
+}
+
+void rhumb_direct(const int n,
+    const double* lat1, const double* lon1,
+    const double* azimuth, const double* range,
+    double* lat2, double* lon2)
+{
+  for (int i = 0; i < n; ++i) {
+    rhumb_direct(lat1[i], lon1[i], azimuth[i], range[i], &lat2[i], &lon2[i]);
+  }
+}
+
+void rhumb_inverse(const int n,
+    const double* lat1, const double* lon1,
+    const double* lat2, const double* lon2,
+    double* azimuth, double* range)
+{
+  for (int i = 0; i < n; ++i) {
+    rhumb_inverse(lat1[i], lon1[i], lat2[i], lon2[i], &azimuth[i], &range[i]);
+  }
+}
+
+void rhumb_intersection(const int n,
+    const double* lat1, const double* lon1,
+    const double* lat2, const double* lon2,
+    const double* lat3, const double* lon3,
+    const double* lat4, const double* lon4,
+    double* lat, double* lon)
+{
+  for (int i = 0; i < n; ++i) {
+    if (not rhumb_intersection(lat1[i], lon1[i], lat2[i], lon2[i],
+          lat3[i], lon3[i], lat4[i], lon4[i], &lat[i], &lon[i])) {
+      lat[i] = NAN;
+      lon[i] = NAN;
+    }
+  }
+}
+
+}  // namespace geofun
@@ -0,0 +1,246 @@
+#ifndef __GEOFUN_BATCH_HPP
+#define __GEOFUN_BATCH_HPP
+
+#include <stdint.h>
+
+#include "geofun.hpp"
+
+namespace geofun {
+
+// Batch kernels operate on structure-of-arrays input and output. All angles
+// are in radians regardless of the angle mode, distances are in meters and
+// azimuths are returned in [0, 2 pi). Pairs are processed in blocks of
+// batch_lanes in loops free of calls into the object model. With mp_fast and
+// the -fno-math-errno -fno-trapping-math of the Makefile the Vincenty lane
+// loops vectorize; with mp_exact each lane calls into libm, so they run
+// scalar.
+static const int batch_lanes = 8;
+
+// Vincenty inverse for n position pairs. Yields the same results as
+// Arc(p1, p2): distance is get_v().get_r(), azimuth is get_v().get_a(),
+// reverse_azimuth is get_r().get_a() and status, when given, is
+// get_status().
+extern void vincenty_inverse(const int n,
+    const double* lat1, const double* lon1,
+    const double* lat2, const double* lon2,
+    double* distance, double* azimuth, double* reverse_azimuth,
+    VincentyStatus* status = 0,
+    const Ellipsoid& ellipsoid = get_earth_model()->get_ellipsoid());
+
+// Vincenty inverse on quantized or float32 positions (see quantize). The
+// angles are decoded per block of lanes, so the positions are read from
+// memory in their compact form only.
+extern void vincenty_inverse(const int n,
+    const int32_t* lat1, const int32_t* lon1,
+    const int32_t* lat2, const int32_t* lon2,
+    double* distance, double* azimuth, double* reverse_azimuth,
+    VincentyStatus* status = 0,
+    const Ellipsoid& ellipsoid = get_earth_model()->get_ellipsoid());
+extern void vincenty_inverse(const int n,
+    const float* lat1, const float* lon1,
+    const float* lat2, const float* lon2,
+    double* distance, double* azimuth, double* reverse_azimuth,
+    VincentyStatus* status = 0,
+    const Ellipsoid& ellipsoid = get_earth_model()->get_ellipsoid());
+
+// Geodesic distances between n positions 1 and m positions 2, written row
+// major to distance[i * m + j]. Azimuths and reverse azimuths are optional
+// and skipped when 0. The matrix is computed in tiles on the shared thread
+// pool; per position terms are computed once.
+extern void distance_matrix(const int n, const double* lat1, const double* lon1,
+    const int m, const double* lat2, const double* lon2,
+    double* distance, double* azimuth = 0, double* reverse_azimuth = 0,
+    const Ellipsoid& ellipsoid = get_earth_model()->get_ellipsoid());
+
+// Symmetric n x n distance matrix between n positions. Only the pairs above
+// the diagonal are solved; the diagonal is zero.
+extern void distance_matrix(const int n, const double* lat, const double* lon,
+    double* distance, double* azimuth = 0, double* reverse_azimuth = 0,
+    const Ellipsoid& ellipsoid = get_earth_model()->get_ellipsoid());
+
+// Constants of the direct problem that depend only on the origin latitude
+// and the initial azimuth. When many vectors share an origin these need to be
+// computed once only.
+struct DirectConstants {
+  DirectConstants(const Ellipsoid& e = get_earth_model()->get_ellipsoid()):
+    ellipsoid(e), sinu1(0), cosu1(1), tanu1(0) {
+    set_azimuth(0);
+  }
+  DirectConstants(const double lat, const double azimuth,
+      const Ellipsoid& e = get_earth_model()->get_ellipsoid()): ellipsoid(e) {
+    set_origin(lat);
+    set_azimuth(azimuth);
+  }
+  void set_origin(const double lat);
+  void set_azimuth(const double azimuth);
+
+  Ellipsoid ellipsoid;  // a copy, so temporaries can be passed
+  double sinu1;
+  double cosu1;
+  double tanu1;
+  double sina1;
+  double cosa1;
+  double sig1;
+  double sina;
+  double sqcosa;
+  double k1;
+  double aa;
+  double bb;
+  double c;
+};
+
+// Vincenty direct for n vectors from n origins. Yields the end positions,
+// the reverse azimuths and optionally the status as Arc(p1, v) does with
+// get_p2(), get_r().get_a() and get_status().
+extern void vincenty_direct(const int n,
+    const double* lat1, const double* lon1,
+    const double* azimuth, const double* range,
+    double* lat2, double* lon2, double* reverse_azimuth,
+    VincentyStatus* status = 0,
+    const Ellipsoid& ellipsoid = get_earth_model()->get_ellipsoid());
+
+// Vincenty direct for n vectors from a single origin. The origin constants
+// are hoisted and the azimuth constants are reused for consecutive vectors
+// with the same azimuth, so fanning out ranges along a few headings is cheap.
+extern void vincenty_direct(const double lat1, const double lon1, const int n,
+    const double* azimuth, const double* range,
+    double* lat2, double* lon2, double* reverse_azimuth,
+    VincentyStatus* status = 0,
+    const Ellipsoid& ellipsoid = get_earth_model()->get_ellipsoid());
+
+// Geodesic from an origin at an initial azimuth, with the constants of the
+// direct problem computed once so that each point along it only takes the
+// sigma iteration. Angles are in radians and distances in meters. The
+// length, when given, is what fraction() and waypoints() refer to. Like the
+// other radian hot path types it is not wrapped for Python.
+struct GeodesicLine {
+  GeodesicLine(const double lat1, const double lon1, const double azimuth,
+      const double length = 0,
+      const Ellipsoid& ellipsoid = get_earth_model()->get_ellipsoid()):
+    _constants(lat1, azimuth, ellipsoid), _lon1(lon1), _length(length) {}
+  // The geodesic of an arc, from its first position along its vector
+  GeodesicLine(const Arc& arc,
+      const Ellipsoid& ellipsoid = get_earth_model()->get_ellipsoid()):
+    _constants(arc.get_p1().value().lat, arc.get_v().value().a, ellipsoid),
+    _lon1(arc.get_p1().value().lon), _length(arc.get_v().value().r) {}
+
+  double get_length() const {
+    return _length;
+  }
+  // Position at a distance from the origin, and the forward azimuth there
+  // when azimuth is given
+  void position(const double distance, double* lat, double* lon,
+      double* azimuth = 0) const;
+  // Position at a fraction of the length
+  void fraction(const double t, double* lat, double* lon, double* azimuth = 0) const {
+    position(t * _length, lat, lon, azimuth);
+  }
+  // Positions at n distances from the origin, solved in blocks of lanes
+  void positions(const int n, const double* distance, double* lat, double* lon,
+      double* azimuth = 0) const;
+  // n evenly spaced waypoints from the origin to the end of the line
+  void waypoints(const int n, double* lat, double* lon) const;
+
+  // Waypoints at a fixed spacing from the origin up to and including the
+  // end of the line, each solved when the iterator reaches it:
+  //   for (PositionValue p: line.waypoints(1000)) ...
+  // Without a positive spacing these are the origin and the end. A spacing
+  // that would take more waypoints than an int counts is widened.
+  struct Waypoints {
+    struct iterator {
+      PositionValue operator*() const {
+        PositionValue p;
+        line->position(std::min(i * spacing, line->_length), &p.lat, &p.lon);
+        return p;
+      }
+      iterator& operator++() {
+        ++i;
+        return *this;
+      }
+      bool operator!=(const iterator& it) const {
+        return i != it.i;
+      }
+      const GeodesicLine* line;
+      double spacing;
+      int i;
+    };
+    iterator begin() const {
+      iterator it = {line, spacing, 0};
+      return it;
+    }
+    iterator end() const {
+      iterator it = {line, spacing, count};
+      return it;
+    }
+    int size() const {
+      return count;
+    }
+    const GeodesicLine* line;
+    double spacing;
+    int count;
+  };
+  Waypoints waypoints(const double spacing) const;
+private:
+  DirectConstants _constants;
+  double _lon1;
+  double _length;
+};
+
+// Rhumb line counterparts of Position + Vector and Position - Position for n
+// elements. rhumb_inverse yields the vector from position 1 to position 2.
+extern void rhumb_direct(const int n,
+    const double* lat1, const double* lon1,
+    const double* azimuth, const double* range,
+    double* lat2, double* lon2);
+extern void rhumb_inverse(const int n,
+    const double* lat1, const double* lon1,
+    const double* lat2, const double* lon2,
+    double* azimuth, double* range);
+
+// Crossings of the rhumb lines from positions 1 to 2 and from positions 3
+// to 4 for n pairs of segments. Pairs that don't cross yield NaN.
+extern void rhumb_intersection(const int n,
+    const double* lat1, const double* lon1,
+    const double* lat2, const double* lon2,
+    const double* lat3, const double* lon3,
+    const double* lat4, const double* lon4,
+    double* lat, double* lon);
+
+// Angles quantized to int32 steps of pi / 2^31 radians, just under a
+// centimeter along a meridian. Angles wrap into [-pi, pi), so a longitude of
+// pi is stored as -pi.
+static const double angle_quantum = pi / 2147483648.0;
+
+extern void quantize(const int n, const double* angle, int32_t* quantized);
+extern void dequantize(const int n, const int32_t* quantized, double* angle);
+// Angles rounded to float32 radians, within 0.12 micro radians or under a
+// meter on the ground
+extern void quantize(const int n, const double* angle, float* quantized);
+extern void dequantize(const int n, const float* quantized, double* angle);
+
+// Batch rhumb line navigation with the earth model fixed at compile time
+template <class Model>
+inline void rhumb_direct(const int n,
+    const double* lat1, const double* lon1,
+    const double* azimuth, const double* range,
+    double* lat2, double* lon2)
+{
+  for (int i = 0; i < n; ++i) {
+    rhumb_direct<Model>(lat1[i], lon1[i], azimuth[i], range[i], &lat2[i], &lon2[i]);
+  }
+}
+
+template <class Model>
+inline void rhumb_inverse(const int n,
+    const double* lat1, const double* lon1,
+    const double* lat2, const double* lon2,
+    double* azimuth, double* range)
+{
+  for (int i = 0; i < n; ++i) {
+    rhumb_inverse<Model>(lat1[i], lon1[i], lat2[i], lon2[i], &azimuth[i], &range[i]);
+  }
+}
+
+};  // namespace geofun
+
+#endif // __GEOFUN_BATCH_HPP
@@ -0,0 +1,136 @@
+#ifndef __GEOFUN_COMPACT_HPP
+#define __GEOFUN_COMPACT_HPP
+
+#include <limits>
+#include <vector>
+
+#include "geofun.hpp"
+#include "geofun_batch.hpp"
+#include "geofun_track.hpp"
+
+namespace geofun {
+
+// Positions stored in 8 bytes each, as arrays of latitudes and longitudes
+// quantized to int32 (just under a centimeter) or rounded to float32 radians
+// (under a meter). Positions are encoded when appended and decoded when
+// accessed; the raw arrays can be passed to the compact batch kernels.
+template <class T>
+struct CompactPositions {
+  void reserve(const int n) {
+    _lat.reserve(n);
+    _lon.reserve(n);
+  }
+  void append(const Position& position) {
+    PositionValue p = position.value();
+    append(1, &p.lat, &p.lon);
+  }
+  // Append n positions given in radians
+  void append(const int n, const double* lat, const double* lon) {
+    if (n <= 0) {
+      return;
+    }
+    const size_t k = _lat.size();
+    _lat.resize(k + n);
+    _lon.resize(k + n);
+    quantize(n, lat, _lat.data() + k);
+    quantize(n, lon, _lon.data() + k);
+  }
+
+  int size() const {
+    return static_cast<int>(_lat.size());
+  }
+  Position operator[](const int i) const {
+    check(i, size());
+    PositionValue p;
+    dequantize(1, &_lat[i], &p.lat);
+    dequantize(1, &_lon[i], &p.lon);
+    return Position(p);
+  }
+  // Decode n positions from first on to radians
+  void decode(const int first, const int n, double* lat, double* lon) const {
+    check(first, size() + 1);
+    check(first + n, size() + 1);
+    dequantize(n, _lat.data() + first, lat);
+    dequantize(n, _lon.data() + first, lon);
+  }
+  const T* lat_data() const {
+    return _lat.data();
+  }
+  const T* lon_data() const {
+    return _lon.data();
+  }
+
+  // Geodesic length and initial azimuth of the size() - 1 legs between
+  // consecutive positions, solved on the compact form
+  void legs(double* distance, double* azimuth = 0) const {
+    if (size() > 1) {
+      vincenty_inverse(size() - 1, _lat.data(), _lon.data(), _lat.data() + 1, _lon.data() + 1,
+          distance, azimuth, 0);
+    }
+  }
+protected:
+  static void check(const int i, const int n) {
+    if (i < 0 or i >= n)
+      throw IndexError(i);
+  }
+
+  std::vector<T> _lat;
+  std::vector<T> _lon;
+};
+
+// Compact positions with a time in seconds for every fix. Unlike Track no
+// distances are kept; to_track() decodes the fixes into one.
+template <class T>
+struct CompactTrack: CompactPositions<T> {
+  void reserve(const int n) {
+    CompactPositions<T>::reserve(n);
+    _time.reserve(n);
+  }
+  void append(const Position& position) {
+    append(position, std::numeric_limits<double>::quiet_NaN());
+  }
+  void append(const Position& position, const double time) {
+    PositionValue p = position.value();
+    append(1, &p.lat, &p.lon, &time);
+  }
+  void append(const int n, const double* lat, const double* lon, const double* time = 0) {
+    if (n <= 0) {
+      return;
+    }
+    CompactPositions<T>::append(n, lat, lon);
+    if (time) {
+      _time.insert(_time.end(), time, time + n);
+    }
+    else {
+      _time.resize(_time.size() + n, std::numeric_limits<double>::quiet_NaN());
+    }
+  }
+
+  double get_time(const int i) const {
+    this->check(i, this->size());
+    return _time[i];
+  }
+  const double* time_data() const {
+    return _time.data();
+  }
+
+  Track to_track(const TrackLegs legs = tl_rhumb) const {
+    const int n = this->size();
+    std::vector<double> lat(n), lon(n);
+    this->decode(0, n, lat.data(), lon.data());
+    Track track(legs);
+    track.append(n, lat.data(), lon.data(), _time.data());
+    return track;
+  }
+private:
+  std::vector<double> _time;
+};
+
+typedef CompactPositions<int32_t> QuantizedPositions;
+typedef CompactPositions<float> FloatPositions;
+typedef CompactTrack<int32_t> QuantizedTrack;
+typedef CompactTrack<float> FloatTrack;
+
+};  // namespace geofun
+
+#endif // __GEOFUN_COMPACT_HPP
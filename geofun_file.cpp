@@ -0,0 +1,281 @@
+#include "geofun_file.hpp"
+#include "geofun_batch.hpp"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+
+// Values are read and written in host order
+#if defined(__BYTE_ORDER__) and __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "geofun files are little endian and the host is not"
+#endif
+
+namespace geofun {
+
+static const char file_magic[8] = {'G', 'E', 'O', 'F', 'U', 'N', '\r', '\n'};
+static const size_t file_header_size = 32;
+
+struct FileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t kind;
+  uint32_t encoding;
+  uint32_t columns;
+  uint64_t records;
+};
+
+static inline size_t padded(const size_t size)
+{
+  return (size + 7) & ~static_cast<size_t>(7);
+}
+
+static inline bool is_time(const FileKind kind, const int column)
+{
+  return kind == fk_track and column == 2;
+}
+
+static FileError file_error(const std::string& path, const std::string& reason)
+{
+  return FileError(path + ": " + reason);
+}
+
+FileReader::FileReader(const std::string& path):
+  _fd(-1), _data(0), _length(0), _size(0)
+{
+  _fd = open(path.c_str(), O_RDONLY);
+  if (_fd < 0)
+    throw file_error(path, strerror(errno));
+  struct stat st;
+  if (fstat(_fd, &st) != 0 or static_cast<size_t>(st.st_size) < file_header_size) {
+    ::close(_fd);
+    throw file_error(path, "not a geofun file");
+  }
+  _length = st.st_size;
+  void* data = mmap(0, _length, PROT_READ, MAP_SHARED, _fd, 0);
+  if (data == MAP_FAILED) {
+    ::close(_fd);
+    throw file_error(path, strerror(errno));
+  }
+  _data = static_cast<const char*>(data);
+
+  // From here on the destructor has to clean up
+  try {
+    FileHeader header;
+    memcpy(&header, _data, sizeof(header));
+    if (memcmp(header.magic, file_magic, sizeof(file_magic)) != 0)
+      throw file_error(path, "not a geofun file");
+    if (header.version != file_version)
+      throw file_error(path, "unsupported version");
+    if (header.kind > fk_lines or header.encoding > fe_int32
+        or header.columns != static_cast<uint32_t>(file_columns(FileKind(header.kind))))
+      throw file_error(path, "corrupt header");
+    _kind = FileKind(header.kind);
+    _encoding = FileEncoding(header.encoding);
+
+    const int columns = file_columns(_kind);
+    size_t offset = file_header_size;
+    while (offset < _length) {
+      uint64_t count;
+      if (_length - offset < sizeof(count))
+        throw file_error(path, "truncated chunk");
+      memcpy(&count, _data + offset, sizeof(count));
+      offset += sizeof(count);
+      if (count > static_cast<uint64_t>(std::numeric_limits<int>::max()))
+        throw file_error(path, "corrupt chunk");
+      FileChunk chunk;
+      chunk.count = static_cast<int>(count);
+      for (int i = 0; i < 4; ++i) {
+        chunk.columns[i] = 0;
+      }
+      for (int i = 0; i < columns; ++i) {
+        const size_t width = is_time(_kind, i) or _encoding == fe_float64 ?
+          sizeof(double) : sizeof(int32_t);
+        const size_t size = padded(count * width);
+        if (_length - offset < size)
+          throw file_error(path, "truncated chunk");
+        chunk.columns[i] = _data + offset;
+        offset += size;
+      }
+      _chunks.push_back(chunk);
+      _size += count;
+    }
+  }
+  catch (...) {
+    munmap(const_cast<char*>(_data), _length);
+    ::close(_fd);
+    throw;
+  }
+}
+
+FileReader::~FileReader()
+{
+  munmap(const_cast<char*>(_data), _length);
+  ::close(_fd);
+}
+
+void FileReader::read(const int i, double* values) const
+{
+  if (i < 0 or i >= file_columns(_kind))
+    throw IndexError(i);
+  for (size_t c = 0; c < _chunks.size(); ++c) {
+    const FileChunk& chunk = _chunks[c];
+    if (_encoding == fe_int32 and not is_time(_kind, i)) {
+      dequantize(chunk.count, chunk.quantized(i), values);
+    }
+    else {
+      memcpy(values, chunk.columns[i], chunk.count * sizeof(double));
+    }
+    values += chunk.count;
+  }
+}
+
+FileWriter::FileWriter(const std::string& path, const FileKind kind,
+    const FileEncoding encoding, const int chunk_size):
+  _file(0), _path(path), _kind(kind), _encoding(encoding),
+  _chunk_size(std::max(chunk_size, 1)), _size(0)
+{
+  _file = fopen(path.c_str(), "wb");
+  if (not _file)
+    throw file_error(path, strerror(errno));
+  FileHeader header;
+  memcpy(header.magic, file_magic, sizeof(file_magic));
+  header.version = file_version;
+  header.kind = kind;
+  header.encoding = encoding;
+  header.columns = file_columns(kind);
+  header.records = 0;
+  try {
+    put(&header, sizeof(header));
+  }
+  catch (const FileError&) {
+    fclose(_file);
+    throw;
+  }
+}
+
+FileWriter::~FileWriter()
+{
+  try {
+    close();
+  }
+  catch (const FileError&) {
+  }
+}
+
+void FileWriter::put(const void* data, const size_t size)
+{
+  if (fwrite(data, 1, size, _file) != size)
+    throw file_error(_path, strerror(errno));
+}
+
+void FileWriter::write(const int n, const double* column0, const double* column1,
+    const double* column2, const double* column3)
+{
+  if (not _file)
+    throw file_error(_path, "writer is closed");
+  const double* columns[] = {column0, column1, column2, column3};
+  const int m = file_columns(_kind);
+  for (int i = 0; i < m; ++i) {
+    if (not columns[i])
+      throw file_error(_path, "missing column");
+  }
+  int done = 0;
+  while (done < n) {
+    const int k = std::min(n - done, _chunk_size - static_cast<int>(_buffer[0].size()));
+    for (int i = 0; i < m; ++i) {
+      _buffer[i].insert(_buffer[i].end(), columns[i] + done, columns[i] + done + k);
+    }
+    done += k;
+    if (static_cast<int>(_buffer[0].size()) == _chunk_size)
+      flush();
+  }
+}
+
+void FileWriter::write(const Position& position)
+{
+  PositionValue p = position.value();
+  write(1, &p.lat, &p.lon);
+}
+
+void FileWriter::write(const Position& position, const double time)
+{
+  PositionValue p = position.value();
+  write(1, &p.lat, &p.lon, &time);
+}
+
+void FileWriter::write(const Line& line)
+{
+  PositionValue p1 = line.get_p1().value();
+  PositionValue p2 = line.get_p2().value();
+  write(1, &p1.lat, &p1.lon, &p2.lat, &p2.lon);
+}
+
+void FileWriter::flush()
+{
+  const uint64_t count = _buffer[0].size();
+  if (count == 0)
+    return;
+  // A chunk that fails halfway is dropped whole, so that a later flush
+  // doesn't write the rest of it after a broken count
+  try {
+    put(&count, sizeof(count));
+    static const char zeros[8] = {0};
+    for (int i = 0; i < file_columns(_kind); ++i) {
+      if (_encoding == fe_int32 and not is_time(_kind, i)) {
+        _quantized.resize(count);
+        quantize(count, _buffer[i].data(), _quantized.data());
+        put(_quantized.data(), count * sizeof(int32_t));
+        put(zeros, padded(count * sizeof(int32_t)) - count * sizeof(int32_t));
+      }
+      else {
+        put(_buffer[i].data(), count * sizeof(double));
+      }
+    }
+  }
+  catch (const FileError&) {
+    for (int i = 0; i < 4; ++i) {
+      _buffer[i].clear();
+    }
+    throw;
+  }
+  for (int i = 0; i < 4; ++i) {
+    _buffer[i].clear();
+  }
+  _size += count;
+}
+
+void FileWriter::close()
+{
+  if (not _file)
+    return;
+  // The file is closed whether or not the last chunk and the record count
+  // make it to disk
+  FILE* file = _file;
+  try {
+    flush();
+  }
+  catch (const FileError&) {
+    _file = 0;
+    fclose(file);
+    throw;
+  }
+  _file = 0;
+  const uint64_t records = _size;
+  bool ok = fseek(file, offsetof(FileHeader, records), SEEK_SET) == 0
+    and fwrite(&records, sizeof(records), 1, file) == 1;
+  int error = errno;
+  if (fclose(file) != 0 and ok) {
+    ok = false;
+    error = errno;
+  }
+  if (not ok)
+    throw file_error(_path, strerror(error));
+}
+
+}  // namespace geofun
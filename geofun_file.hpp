@@ -0,0 +1,153 @@
+#ifndef __GEOFUN_FILE_HPP
+#define __GEOFUN_FILE_HPP
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "geofun.hpp"
+
+namespace geofun {
+
+// Binary files of positions, timestamped track fixes or line segments,
+// stored column wise so the batch kernels can run on a memory mapped file
+// without copying it. All values are little endian, which is also the byte
+// order of the hosts the library builds on. Version 1 layout:
+//
+//   header, 32 bytes:
+//     char     magic[8]   "GEOFUN\r\n"
+//     uint32   version    1
+//     uint32   kind       FileKind
+//     uint32   encoding   FileEncoding
+//     uint32   columns    2, 3 or 4
+//     uint64   records    total over all chunks, 0 if the writer was not closed
+//   chunks until the end of the file:
+//     uint64   count      records in the chunk
+//     columns  count values each, zero padded to a multiple of 8 bytes
+//
+// The columns are lat, lon for positions, lat, lon, time for tracks and
+// lat1, lon1, lat2, lon2 for lines. Angles are radians, stored as float64 or
+// quantized to int32 (see quantize in geofun_batch.hpp). Times are seconds
+// and always float64.
+typedef enum {fk_positions, fk_track, fk_lines} FileKind;
+typedef enum {fe_float64, fe_int32} FileEncoding;
+
+static const uint32_t file_version = 1;
+
+struct FileError {
+  FileError(const std::string& message): _message(message) {}
+  const char* what() const throw() {
+    return _message.c_str();
+  }
+private:
+  std::string _message;
+};
+
+// Number of columns in a file of a kind
+inline int file_columns(const FileKind kind)
+{
+  return kind == fk_positions ? 2 : kind == fk_track ? 3 : 4;
+}
+
+// A chunk of a mapped file. The columns point into the mapping; for the
+// float64 encoding angle(i) can be passed to the batch kernels directly.
+struct FileChunk {
+  const double* angle(const int i) const {
+    return static_cast<const double*>(columns[i]);
+  }
+  const int32_t* quantized(const int i) const {
+    return static_cast<const int32_t*>(columns[i]);
+  }
+  const double* time() const {
+    return static_cast<const double*>(columns[2]);
+  }
+
+  int count;
+  const void* columns[4];
+};
+
+// Read only memory mapping of a file. The chunks are indexed when the file is
+// opened by walking the chunk headers; no data is read until it is used.
+struct FileReader {
+  FileReader(const std::string& path);
+  ~FileReader();
+
+  FileKind get_kind() const {
+    return _kind;
+  }
+  FileEncoding get_encoding() const {
+    return _encoding;
+  }
+  int chunks() const {
+    return static_cast<int>(_chunks.size());
+  }
+  const FileChunk& chunk(const int i) const {
+    if (i < 0 or i >= chunks())
+      throw IndexError(i);
+    return _chunks[i];
+  }
+  // Offset in bytes from the start of the file of column i of chunk c, for
+  // mapping the column elsewhere
+  size_t column_offset(const int c, const int i) const {
+    if (i < 0 or i >= file_columns(_kind))
+      throw IndexError(i);
+    return static_cast<const char*>(chunk(c).columns[i]) - _data;
+  }
+  // Total number of records
+  int64_t size() const {
+    return _size;
+  }
+  // Copy column i of all chunks to values, decoding quantized angles to
+  // radians. values must hold size() elements.
+  void read(const int i, double* values) const;
+private:
+  FileReader(const FileReader&);
+  FileReader& operator=(const FileReader&);
+
+  int _fd;
+  const char* _data;
+  size_t _length;
+  FileKind _kind;
+  FileEncoding _encoding;
+  int64_t _size;
+  std::vector<FileChunk> _chunks;
+};
+
+// Streaming writer. Records are buffered and written a chunk of chunk_size
+// records at a time, so files of any size are written in bounded memory.
+// close(), also called by the destructor, writes the last chunk and the
+// record count in the header.
+struct FileWriter {
+  FileWriter(const std::string& path, const FileKind kind,
+      const FileEncoding encoding = fe_float64, const int chunk_size = 65536);
+  ~FileWriter();
+
+  // Append n records given as one array per column, in radians and seconds.
+  // Columns beyond those of the kind are ignored.
+  void write(const int n, const double* column0, const double* column1,
+      const double* column2 = 0, const double* column3 = 0);
+  void write(const Position& position);
+  void write(const Position& position, const double time);
+  void write(const Line& line);
+  void flush();
+  void close();
+private:
+  FileWriter(const FileWriter&);
+  FileWriter& operator=(const FileWriter&);
+
+  void put(const void* data, const size_t size);
+
+  FILE* _file;
+  std::string _path;
+  FileKind _kind;
+  FileEncoding _encoding;
+  int _chunk_size;
+  int64_t _size;
+  std::vector<double> _buffer[4];
+  std::vector<int32_t> _quantized;
+};
+
+};  // namespace geofun
+
+#endif // __GEOFUN_FILE_HPP
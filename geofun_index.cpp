@@ -0,0 +1,792 @@
+#include "geofun_index.hpp"
+#include "geofun_pool.hpp"
+#include "geofun_batch.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <set>
+#include <utility>
+
+namespace geofun {
+
+// Maximum number of children of an R-tree node
+static const int node_capacity = 16;
+
+bool LatLonBox::contains(const Position& position) const
+{
+  PositionValue p = position.value();
+  return p.lat >= min_lat and p.lat <= max_lat
+      and lon_span(min_lon, p.lon) <= lon_span(min_lon, max_lon);
+}
+
+LatLonBox bounding_box(const Line& line)
+{
+  PositionValue p1 = line.get_p1().value();
+  PositionValue p2 = line.get_p2().value();
+  bool eastward = line.get_v().value().a <= pi;
+  LatLonBox box;
+  box.min_lat = std::min(p1.lat, p2.lat);
+  box.max_lat = std::max(p1.lat, p2.lat);
+  box.min_lon = eastward ? p1.lon : p2.lon;
+  box.max_lon = eastward ? p2.lon : p1.lon;
+  return box;
+}
+
+// Whether the first box lies entirely within the second
+static bool box_within(const LatLonBox& inner, const LatLonBox& outer)
+{
+  return inner.min_lat >= outer.min_lat and inner.max_lat <= outer.max_lat
+      and lon_span(outer.min_lon, inner.min_lon) + lon_span(inner.min_lon, inner.max_lon)
+          <= lon_span(outer.min_lon, outer.max_lon);
+}
+
+// Split a box crossing the antimeridian in a box on either side of it
+static int split_box(const LatLonBox& box, LatLonBox* boxes)
+{
+  boxes[0] = box;
+  if (not box.crosses_antimeridian()) {
+    return 1;
+  }
+  boxes[0].max_lon = pi;
+  boxes[1] = box;
+  boxes[1].min_lon = -pi;
+  return 2;
+}
+
+int LineIndex::split(const LatLonBox& box, Rect* rects)
+{
+  LatLonBox boxes[2];
+  int n = split_box(box, boxes);
+  for (int i = 0; i < n; ++i) {
+    Rect rect = {boxes[i].min_lat, boxes[i].max_lat, boxes[i].min_lon, boxes[i].max_lon};
+    rects[i] = rect;
+  }
+  return n;
+}
+
+// Sort items in sort-tile-recursive order: slices by longitude, each slice
+// sorted by latitude
+template <class T>
+static void str_sort(std::vector<T>& items)
+{
+  const size_t n = items.size();
+  const size_t pages = (n + node_capacity - 1) / node_capacity;
+  const size_t slice = size_t(ceil(sqrt(double(pages)))) * node_capacity;
+  std::sort(items.begin(), items.end(), [](const T& t1, const T& t2) {
+    return t1.rect.min_lon + t1.rect.max_lon < t2.rect.min_lon + t2.rect.max_lon;
+  });
+  for (size_t i = 0; i < n; i += slice) {
+    std::sort(items.begin() + i, items.begin() + std::min(i + slice, n),
+        [](const T& t1, const T& t2) {
+      return t1.rect.min_lat + t1.rect.max_lat < t2.rect.min_lat + t2.rect.max_lat;
+    });
+  }
+}
+
+void LineIndex::build()
+{
+  struct Item {
+    Rect rect;
+    int entry;
+  };
+  std::vector<Item> items;
+  for (int i = 0; i < size(); ++i) {
+    Rect rects[2];
+    int k = split(bounding_box(_lines[i]), rects);
+    for (int j = 0; j < k; ++j) {
+      Item item = {rects[j], i};
+      items.push_back(item);
+    }
+  }
+  _indexed = size();
+  _rects.clear();
+  _entries.clear();
+  _nodes.clear();
+  if (items.empty()) {
+    return;
+  }
+
+  str_sort(items);
+  std::vector<Node> level;
+  for (size_t i = 0; i < items.size(); ++i) {
+    if (i % node_capacity == 0) {
+      Node leaf = {items[i].rect, int(i), 0, true};
+      level.push_back(leaf);
+    }
+    level.back().rect.extend(items[i].rect);
+    ++level.back().count;
+    _rects.push_back(items[i].rect);
+    _entries.push_back(items[i].entry);
+  }
+
+  // Nodes of a level are stored contiguously in STR order, so the children
+  // of a parent are a range
+  for (;;) {
+    str_sort(level);
+    const int base = static_cast<int>(_nodes.size());
+    _nodes.insert(_nodes.end(), level.begin(), level.end());
+    if (level.size() == 1) {
+      break;
+    }
+    std::vector<Node> parents;
+    for (size_t i = 0; i < level.size(); ++i) {
+      if (i % node_capacity == 0) {
+        Node parent = {level[i].rect, base + int(i), 0, false};
+        parents.push_back(parent);
+      }
+      parents.back().rect.extend(level[i].rect);
+      ++parents.back().count;
+    }
+    level.swap(parents);
+  }
+}
+
+void LineIndex::search(const Rect* rects, const int n, std::vector<int>* result) const
+{
+  if (not _nodes.empty()) {
+    std::vector<int> stack(1, static_cast<int>(_nodes.size()) - 1);
+    while (not stack.empty()) {
+      const Node& node = _nodes[stack.back()];
+      stack.pop_back();
+      bool hit = false;
+      for (int k = 0; k < n; ++k) {
+        hit = hit or node.rect.overlaps(rects[k]);
+      }
+      if (not hit) {
+        continue;
+      }
+      for (int c = node.first; c < node.first + node.count; ++c) {
+        if (not node.leaf) {
+          stack.push_back(c);
+          continue;
+        }
+        for (int k = 0; k < n; ++k) {
+          if (_rects[c].overlaps(rects[k])) {
+            result->push_back(_entries[c]);
+            break;
+          }
+        }
+      }
+    }
+  }
+  for (int i = _indexed; i < size(); ++i) {
+    Rect line_rects[2];
+    int m = split(bounding_box(_lines[i]), line_rects);
+    bool hit = false;
+    for (int j = 0; j < m; ++j) {
+      for (int k = 0; k < n; ++k) {
+        hit = hit or line_rects[j].overlaps(rects[k]);
+      }
+    }
+    if (hit) {
+      result->push_back(i);
+    }
+  }
+  // Lines crossing the antimeridian may have been found twice
+  std::sort(result->begin(), result->end());
+  result->erase(std::unique(result->begin(), result->end()), result->end());
+}
+
+std::vector<int> LineIndex::overlapping(const LatLonBox& box) const
+{
+  Rect rects[2];
+  int n = split(box, rects);
+  std::vector<int> result;
+  search(rects, n, &result);
+  return result;
+}
+
+std::vector<int> LineIndex::within(const LatLonBox& box) const
+{
+  std::vector<int> candidates = overlapping(box);
+  std::vector<int> result;
+  for (size_t i = 0; i < candidates.size(); ++i) {
+    if (box_within(bounding_box(_lines[candidates[i]]), box)) {
+      result.push_back(candidates[i]);
+    }
+  }
+  return result;
+}
+
+std::vector<int> LineIndex::intersecting(const Line& line) const
+{
+  std::vector<int> candidates = overlapping(bounding_box(line));
+  std::vector<int> result;
+  for (size_t i = 0; i < candidates.size(); ++i) {
+    if (_lines[candidates[i]].intersects(line)) {
+      result.push_back(candidates[i]);
+    }
+  }
+  return result;
+}
+
+std::vector<std::vector<int> > LineIndex::intersecting(const std::vector<Line>& lines) const
+{
+  std::vector<std::vector<int> > result(lines.size());
+  ThreadPool::instance().run(static_cast<int>(lines.size()), [&](const int i) {
+    result[i] = intersecting(lines[i]);
+  });
+  return result;
+}
+
+std::vector<std::vector<int> > LineIndex::within(const std::vector<LatLonBox>& boxes) const
+{
+  std::vector<std::vector<int> > result(boxes.size());
+  ThreadPool::instance().run(static_cast<int>(boxes.size()), [&](const int i) {
+    result[i] = within(boxes[i]);
+  });
+  return result;
+}
+
+// Query position with what it takes to bound and solve distances from it
+struct PositionIndex::Query {
+  Query(const Position& position, const PositionDistance distance):
+    position(position.value()), point(nvector(this->position)), distance(distance),
+    model(get_earth_model()) {
+    // The normal of the ellipsoid turns by at most the largest curvature,
+    // 1 / (a (1 - e2)), per meter along any path. The margin covers the
+    // rounding of the chords.
+    const Ellipsoid& e = model->get_ellipsoid();
+    radius = e.a * (1 - e.e2) * (1 - 1E-9);
+  }
+  // Lower bound of the distance to the points of a node
+  double bound(const Node& node) const {
+    const double q[3] = {point.x, point.y, point.z};
+    double sq = 0;
+    for (int i = 0; i < 3; ++i) {
+      const double d = std::max(std::max(node.min[i] - q[i], q[i] - node.max[i]), 0.0);
+      sq += d * d;
+    }
+    return radius * 2 * asin(std::min(0.5 * sqrt(sq), 1.0));
+  }
+
+  PositionValue position;
+  Cartesian point;
+  PositionDistance distance;
+  EarthModel* model;
+  double radius;
+};
+
+PositionIndex::PositionIndex(const std::vector<Position>& positions)
+{
+  const int n = static_cast<int>(positions.size());
+  std::vector<double> lat(n), lon(n);
+  for (int i = 0; i < n; ++i) {
+    PositionValue p = positions[i].value();
+    lat[i] = p.lat;
+    lon[i] = p.lon;
+  }
+  build(n, lat.data(), lon.data());
+}
+
+PositionIndex::PositionIndex(const int n, const double* lat, const double* lon)
+{
+  build(n, lat, lon);
+}
+
+void PositionIndex::build(const int n, const double* lat, const double* lon)
+{
+  _positions.resize(n);
+  _points.resize(n);
+  _order.resize(n);
+  for (int i = 0; i < n; ++i) {
+    PositionValue p = {lat[i], lon[i]};
+    _positions[i] = p;
+    _points[i] = nvector(p);
+    _order[i] = i;
+  }
+  if (n > 0) {
+    build_node(0, n);
+  }
+  // Store the points in tree order, so that leaves are contiguous
+  std::vector<Cartesian> points(n);
+  _lat.resize(n);
+  _lon.resize(n);
+  for (int i = 0; i < n; ++i) {
+    points[i] = _points[_order[i]];
+    _lat[i] = lat[_order[i]];
+    _lon[i] = lon[_order[i]];
+  }
+  _points.swap(points);
+}
+
+static inline double coordinate(const Cartesian& c, const int axis)
+{
+  return axis == 0 ? c.x : axis == 1 ? c.y : c.z;
+}
+
+int PositionIndex::build_node(const int first, const int count)
+{
+  const int index = static_cast<int>(_nodes.size());
+  Node node;
+  for (int k = 0; k < 3; ++k) {
+    node.min[k] = std::numeric_limits<double>::infinity();
+    node.max[k] = -std::numeric_limits<double>::infinity();
+  }
+  for (int i = first; i < first + count; ++i) {
+    const Cartesian& c = _points[_order[i]];
+    const double v[3] = {c.x, c.y, c.z};
+    for (int k = 0; k < 3; ++k) {
+      node.min[k] = std::min(node.min[k], v[k]);
+      node.max[k] = std::max(node.max[k], v[k]);
+    }
+  }
+  node.first = first;
+  node.count = count;
+  node.left = -1;
+  node.right = -1;
+  _nodes.push_back(node);
+  if (count <= batch_lanes) {
+    return index;
+  }
+
+  // Split at the median of the widest axis
+  int axis = 0;
+  for (int k = 1; k < 3; ++k) {
+    if (node.max[k] - node.min[k] > node.max[axis] - node.min[axis])
+      axis = k;
+  }
+  const std::vector<Cartesian>& points = _points;
+  std::vector<int>::iterator begin = _order.begin() + first;
+  std::nth_element(begin, begin + count / 2, begin + count, [&](const int i, const int j) {
+    return coordinate(points[i], axis) < coordinate(points[j], axis);
+  });
+  const int left = build_node(first, count / 2);
+  const int right = build_node(first + count / 2, count - count / 2);
+  _nodes[index].left = left;
+  _nodes[index].right = right;
+  return index;
+}
+
+// Visits nodes nearest first and stops at the first one whose distance bound
+// exceeds the limit of the visitor. Leaves have their distances solved in
+// one batch.
+template <class Visit>
+void PositionIndex::search(const Query& query, Visit& visit) const
+{
+  if (_nodes.empty()) {
+    return;
+  }
+  typedef std::pair<double, int> Entry;
+  std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry> > queue;
+  queue.push(Entry(query.bound(_nodes[0]), 0));
+  const int L = batch_lanes;
+  double lat[L], lon[L], distance[L], azimuth[L];
+  for (int j = 0; j < L; ++j) {
+    lat[j] = query.position.lat;
+    lon[j] = query.position.lon;
+  }
+  while (not queue.empty() and queue.top().first <= visit.limit()) {
+    const Node& node = _nodes[queue.top().second];
+    queue.pop();
+    if (node.left >= 0) {
+      const int children[] = {node.left, node.right};
+      for (int c = 0; c < 2; ++c) {
+        const double bound = query.bound(_nodes[children[c]]);
+        if (bound <= visit.limit())
+          queue.push(Entry(bound, children[c]));
+      }
+      continue;
+    }
+    const int first = node.first;
+    if (query.distance == pd_geodesic) {
+      vincenty_inverse(node.count, lat, lon, &_lat[first], &_lon[first],
+          distance, 0, 0, 0, query.model->get_ellipsoid());
+    }
+    else {
+      for (int j = 0; j < node.count; ++j) {
+        query.model->rhumb_inverse(lat[j], lon[j], _lat[first + j], _lon[first + j],
+            &azimuth[j], &distance[j]);
+      }
+    }
+    for (int j = 0; j < node.count; ++j) {
+      visit.add(_order[first + j], distance[j]);
+    }
+  }
+}
+
+static bool closer(const Neighbour& n1, const Neighbour& n2)
+{
+  return n1.distance < n2.distance or (n1.distance == n2.distance and n1.index < n2.index);
+}
+
+std::vector<Neighbour> PositionIndex::nearest(const Position& position, const int k,
+    const PositionDistance distance) const
+{
+  // Keeps the k nearest found so far in a heap with the farthest on top
+  struct Visit {
+    double limit() const {
+      return static_cast<int>(found.size()) < k ?
+        std::numeric_limits<double>::infinity() : found.front().distance;
+    }
+    void add(const int index, const double distance) {
+      Neighbour n = {index, distance};
+      if (static_cast<int>(found.size()) < k) {
+        found.push_back(n);
+        std::push_heap(found.begin(), found.end(), closer);
+      }
+      else if (closer(n, found.front())) {
+        std::pop_heap(found.begin(), found.end(), closer);
+        found.back() = n;
+        std::push_heap(found.begin(), found.end(), closer);
+      }
+    }
+    int k;
+    std::vector<Neighbour> found;
+  } visit;
+  visit.k = k;
+  if (k > 0) {
+    search(Query(position, distance), visit);
+  }
+  std::sort_heap(visit.found.begin(), visit.found.end(), closer);
+  return visit.found;
+}
+
+std::vector<Neighbour> PositionIndex::within(const Position& position, const double radius,
+    const PositionDistance distance) const
+{
+  struct Visit {
+    double limit() const {
+      return radius;
+    }
+    void add(const int index, const double distance) {
+      if (distance <= radius) {
+        Neighbour n = {index, distance};
+        found.push_back(n);
+      }
+    }
+    double radius;
+    std::vector<Neighbour> found;
+  } visit;
+  visit.radius = radius;
+  search(Query(position, distance), visit);
+  std::sort(visit.found.begin(), visit.found.end(), closer);
+  return visit.found;
+}
+
+std::vector<std::vector<Neighbour> > PositionIndex::nearest(
+    const std::vector<Position>& positions, const int k, const PositionDistance distance) const
+{
+  std::vector<std::vector<Neighbour> > result(positions.size());
+  ThreadPool::instance().run(static_cast<int>(positions.size()), [&](const int i) {
+    result[i] = nearest(positions[i], k, distance);
+  });
+  return result;
+}
+
+std::vector<std::vector<Neighbour> > PositionIndex::within(
+    const std::vector<Position>& positions, const double radius,
+    const PositionDistance distance) const
+{
+  std::vector<std::vector<Neighbour> > result(positions.size());
+  ThreadPool::instance().run(static_cast<int>(positions.size()), [&](const int i) {
+    result[i] = within(positions[i], radius, distance);
+  });
+  return result;
+}
+
+std::vector<Crossing> crossings(const std::vector<Line>& lines1, const std::vector<Line>& lines2)
+{
+  // Sweep the boxes of both sets by latitude. Each set keeps the boxes
+  // the sweep is in, ordered by west edge, and expires them by north edge.
+  // The boxes are kept apart by width in powers of eight, so that a query
+  // only goes back west by the widest box of each class and one wide box
+  // doesn't make every query scan the whole set.
+  const int classes = 12;
+  struct Event {
+    LatLonBox box;
+    int set;
+    int line;
+    int width_class;
+  };
+  std::vector<Event> events;
+  double width[2][classes] = {};
+  const std::vector<Line>* sets[2] = {&lines1, &lines2};
+  for (int s = 0; s < 2; ++s) {
+    for (size_t i = 0; i < sets[s]->size(); ++i) {
+      LatLonBox boxes[2];
+      int n = split_box(bounding_box((*sets[s])[i]), boxes);
+      for (int j = 0; j < n; ++j) {
+        const double w = boxes[j].max_lon - boxes[j].min_lon;
+        int exponent;
+        frexp(w, &exponent);
+        const int c = w > 0 ? std::min(std::max(3 - exponent, 0) / 3, classes - 1) : classes - 1;
+        Event event = {boxes[j], s, int(i), c};
+        events.push_back(event);
+        width[s][c] = std::max(width[s][c], w);
+      }
+    }
+  }
+  std::sort(events.begin(), events.end(), [](const Event& e1, const Event& e2) {
+    return e1.box.min_lat < e2.box.min_lat;
+  });
+
+  typedef std::pair<double, int> Key;
+  std::set<Key> active[2][classes];
+  std::priority_queue<Key, std::vector<Key>, std::greater<Key> > expiry[2];
+  std::vector<std::pair<int, int> > candidates;
+  for (size_t e = 0; e < events.size(); ++e) {
+    const LatLonBox& box = events[e].box;
+    for (int s = 0; s < 2; ++s) {
+      while (not expiry[s].empty() and expiry[s].top().first < box.min_lat) {
+        const Event& expired = events[expiry[s].top().second];
+        active[s][expired.width_class].erase(Key(expired.box.min_lon, expiry[s].top().second));
+        expiry[s].pop();
+      }
+    }
+    // Boxes of the other set starting further west than the widest box of
+    // their class can't reach this one
+    const int other = 1 - events[e].set;
+    for (int c = 0; c < classes; ++c) {
+      if (active[other][c].empty()) {
+        continue;
+      }
+      std::set<Key>::const_iterator it = active[other][c].lower_bound(
+          Key(box.min_lon - width[other][c], -1));
+      for (; it != active[other][c].end() and it->first <= box.max_lon; ++it) {
+        const Event& event = events[it->second];
+        if (event.box.max_lon >= box.min_lon) {
+          candidates.push_back(events[e].set == 0 ?
+              std::make_pair(events[e].line, event.line) :
+              std::make_pair(event.line, events[e].line));
+        }
+      }
+    }
+    active[events[e].set][events[e].width_class].insert(Key(box.min_lon, int(e)));
+    expiry[events[e].set].push(Key(box.max_lat, int(e)));
+  }
+  // Pairs crossing the antimeridian may have been found twice
+  std::sort(candidates.begin(), candidates.end());
+  candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+  std::vector<Crossing> found(candidates.size());
+  std::vector<char> hit(candidates.size());
+  ThreadPool::instance().run(static_cast<int>(candidates.size()), [&](const int i) {
+    const Line& line1 = lines1[candidates[i].first];
+    const Line& line2 = lines2[candidates[i].second];
+    hit[i] = line1.intersects(line2);
+    if (hit[i]) {
+      found[i].first = candidates[i].first;
+      found[i].second = candidates[i].second;
+      found[i].position = line1.intersection(line2);
+    }
+  });
+  std::vector<Crossing> result;
+  for (size_t i = 0; i < found.size(); ++i) {
+    if (hit[i]) {
+      result.push_back(found[i]);
+    }
+  }
+  return result;
+}
+
+Polygon::Polygon(const std::vector<Position>& vertices)
+{
+  const int n = static_cast<int>(vertices.size());
+  std::vector<double> lat(n), lon(n);
+  for (int i = 0; i < n; ++i) {
+    PositionValue p = vertices[i].value();
+    lat[i] = p.lat;
+    lon[i] = p.lon;
+  }
+  build(n, lat.data(), lon.data());
+}
+
+Polygon::Polygon(const std::vector<Line>& edges)
+{
+  const int n = static_cast<int>(edges.size());
+  std::vector<double> lat(n), lon(n);
+  for (int i = 0; i < n; ++i) {
+    PositionValue p = edges[i].get_p1().value();
+    lat[i] = p.lat;
+    lon[i] = p.lon;
+  }
+  build(n, lat.data(), lon.data());
+}
+
+Polygon::Polygon(const int n, const double* lat, const double* lon)
+{
+  build(n, lat, lon);
+}
+
+void Polygon::build(const int n, const double* lat, const double* lon)
+{
+  _model = get_earth_model();
+  _lat.assign(lat, lat + n);
+  _lon.assign(lon, lon + n);
+  _north = false;
+  _box = LatLonBox();
+  _min_x = _max_x = 0;
+  _band_width = 1;
+  _bands.assign(2, 0);
+  _edges.clear();
+  if (n < 3) {
+    return;
+  }
+
+  // Vertices with unwrapped longitudes, closed by the first vertex again,
+  // which ends a whole turn away when the edges wind around a pole
+  const Ellipsoid& e = _model->get_ellipsoid();
+  std::vector<double> x(n + 1), y(n + 1);
+  x[0] = lon[0];
+  y[0] = e.isometric_latitude(lat[0]);
+  _box.min_lat = _box.max_lat = lat[0];
+  for (int i = 1; i <= n; ++i) {
+    const int k = i % n;
+    x[i] = x[i - 1] + angle_diff(lon[k], lon[i - 1]);
+    y[i] = k == 0 ? y[0] : e.isometric_latitude(lat[k]);
+    _box.min_lat = std::min(_box.min_lat, lat[k]);
+    _box.max_lat = std::max(_box.max_lat, lat[k]);
+  }
+  _min_x = *std::min_element(x.begin(), x.end());
+  _max_x = *std::max_element(x.begin(), x.end());
+  const double winding = x[n] - x[0];
+  if (fabs(winding) > pi) {
+    _north = winding > 0;
+    if (_north) {
+      _box.max_lat = half_pi;
+    }
+    else {
+      _box.min_lat = -half_pi;
+    }
+  }
+  if (_max_x - _min_x >= two_pi) {
+    _box.min_lon = -pi;
+    _box.max_lon = pi;
+  }
+  else {
+    _box.min_lon = angle_pipi(_min_x);
+    _box.max_lon = angle_pipi(_max_x);
+  }
+
+  // Bucket the edges by band, counting them first. Edges along a meridian
+  // never cross another meridian and are left out.
+  const int bands = n;
+  if (_max_x > _min_x) {
+    _band_width = (_max_x - _min_x) / bands;
+  }
+  auto band = [&](const double at) {
+    return std::min(static_cast<int>((at - _min_x) / _band_width), bands - 1);
+  };
+  std::vector<Edge> edges;
+  for (int i = 0; i < n; ++i) {
+    if (x[i] == x[i + 1]) {
+      continue;
+    }
+    const int west = x[i] < x[i + 1] ? i : i + 1;
+    const int east = 2 * i + 1 - west;
+    Edge edge = {x[west], x[east], y[west], (y[east] - y[west]) / (x[east] - x[west])};
+    edges.push_back(edge);
+  }
+  _bands.assign(bands + 1, 0);
+  for (const Edge& edge: edges) {
+    for (int b = band(edge.x1); b <= band(edge.x2); ++b) {
+      ++_bands[b + 1];
+    }
+  }
+  for (int b = 0; b < bands; ++b) {
+    _bands[b + 1] += _bands[b];
+  }
+  _edges.resize(_bands[bands]);
+  std::vector<int> next(_bands.begin(), _bands.end() - 1);
+  for (const Edge& edge: edges) {
+    for (int b = band(edge.x1); b <= band(edge.x2); ++b) {
+      _edges[next[b]++] = edge;
+    }
+  }
+}
+
+bool Polygon::contains(const double lat, const double lon) const
+{
+  if (_edges.empty() or lat < _box.min_lat or lat > _box.max_lat
+      or lon_span(_box.min_lon, lon) > lon_span(_box.min_lon, _box.max_lon)) {
+    return false;
+  }
+  // Count the edges crossing the meridian north of the position, at every
+  // whole turn of its longitude within the range of the edges. Edges are
+  // half open to the east, so a meridian through a vertex counts one of
+  // the two edges meeting there.
+  const double y = _model->get_ellipsoid().isometric_latitude(lat);
+  const int bands = static_cast<int>(_bands.size()) - 1;
+  bool inside = _north;
+  for (double x = _min_x + angle_2pi(lon - _min_x); x < _max_x; x += two_pi) {
+    const int b = std::min(static_cast<int>((x - _min_x) / _band_width), bands - 1);
+    for (int k = _bands[b]; k < _bands[b + 1]; ++k) {
+      const Edge& edge = _edges[k];
+      if (x >= edge.x1 and x < edge.x2 and edge.y1 + (x - edge.x1) * edge.slope > y) {
+        inside = not inside;
+      }
+    }
+  }
+  return inside;
+}
+
+void Polygon::contains(const int n, const double* lat, const double* lon, char* inside) const
+{
+  for (int i = 0; i < n; ++i) {
+    inside[i] = contains(lat[i], lon[i]);
+  }
+}
+
+// Bounding box of a polygon with its longitude extent, for testing many
+// polygons from contiguous memory
+struct PolygonBox {
+  PolygonBox(const LatLonBox& box):
+    min_lat(box.min_lat), max_lat(box.max_lat), min_lon(box.min_lon),
+    span(lon_span(box.min_lon, box.max_lon)) {}
+  bool contains(const double lat, const double lon) const {
+    return lat >= min_lat and lat <= max_lat and lon_span(min_lon, lon) <= span;
+  }
+  double min_lat;
+  double max_lat;
+  double min_lon;
+  double span;
+};
+
+void containing(const std::vector<Polygon>& polygons, const int n,
+    const double* lat, const double* lon, char* inside)
+{
+  const int m = static_cast<int>(polygons.size());
+  std::vector<PolygonBox> boxes;
+  for (const Polygon& polygon: polygons) {
+    boxes.push_back(PolygonBox(polygon.get_bounding_box()));
+  }
+  const int block = 256;
+  ThreadPool::instance().run((n + block - 1) / block, [&](const int b) {
+    const int end = std::min(n, (b + 1) * block);
+    for (int i = b * block; i < end; ++i) {
+      char* row = inside + static_cast<size_t>(i) * m;
+      for (int j = 0; j < m; ++j) {
+        row[j] = boxes[j].contains(lat[i], lon[i]) and polygons[j].contains(lat[i], lon[i]);
+      }
+    }
+  });
+}
+
+std::vector<std::vector<int> > containing(const std::vector<Polygon>& polygons,
+    const std::vector<Position>& positions)
+{
+  const int n = static_cast<int>(positions.size());
+  const int m = static_cast<int>(polygons.size());
+  std::vector<double> lat(n), lon(n);
+  for (int i = 0; i < n; ++i) {
+    PositionValue p = positions[i].value();
+    lat[i] = p.lat;
+    lon[i] = p.lon;
+  }
+  std::vector<char> inside(static_cast<size_t>(n) * m);
+  containing(polygons, n, lat.data(), lon.data(), inside.data());
+  std::vector<std::vector<int> > result(n);
+  for (int i = 0; i < n; ++i) {
+    for (int j = 0; j < m; ++j) {
+      if (inside[static_cast<size_t>(i) * m + j]) {
+        result[i].push_back(j);
+      }
+    }
+  }
+  return result;
+}
+
+}  // namespace geofun
@@ -0,0 +1,264 @@
+#ifndef __GEOFUN_INDEX_HPP
+#define __GEOFUN_INDEX_HPP
+
+#include <vector>
+
+#include "geofun.hpp"
+#include "geofun_nvector.hpp"
+
+namespace geofun {
+
+// Eastward extent of the longitude interval from min_lon to max_lon
+inline double lon_span(const double min_lon, const double max_lon)
+{
+  return max_lon >= min_lon ? max_lon - min_lon : max_lon - min_lon + two_pi;
+}
+
+// Latitude/longitude box. Longitudes run eastward from min_lon to max_lon, so
+// a box with min_lon > max_lon crosses the antimeridian. Values are stored
+// in radians.
+struct LatLonBox {
+  LatLonBox(): min_lat(0), max_lat(0), min_lon(0), max_lon(0) {}
+  LatLonBox(const Position& south_west, const Position& north_east):
+    min_lat(south_west.value().lat), max_lat(north_east.value().lat),
+    min_lon(south_west.value().lon), max_lon(north_east.value().lon) {}
+  bool crosses_antimeridian() const {
+    return min_lon > max_lon;
+  }
+  bool contains(const Position& position) const;
+  double min_lat;
+  double max_lat;
+  double min_lon;
+  double max_lon;
+};
+
+// Bounding box of a line, as given by its min_lat, max_lat, min_lon and
+// max_lon
+extern LatLonBox bounding_box(const Line& line);
+
+// Static R-tree over Line segments, bulk loaded with the sort-tile-recursive
+// algorithm. Segments crossing the antimeridian are indexed with a box on
+// either side. Segments added after the last build() are still found by the
+// queries, but are searched linearly until the next build().
+struct LineIndex {
+  LineIndex(): _indexed(0) {}
+  LineIndex(const std::vector<Line>& lines): _lines(lines), _indexed(0) {
+    build();
+  }
+  void add(const Line& line) {
+    _lines.push_back(line);
+  }
+  void build();
+
+  int size() const {
+    return static_cast<int>(_lines.size());
+  }
+  const Line& operator[](const int i) const {
+    if (i < 0 or i >= size())
+      throw IndexError(i);
+    return _lines[i];
+  }
+
+  // Indices of the segments that intersect line
+  std::vector<int> intersecting(const Line& line) const;
+  // Indices of the segments with a bounding box overlapping box
+  std::vector<int> overlapping(const LatLonBox& box) const;
+  // Indices of the segments that lie entirely within box
+  std::vector<int> within(const LatLonBox& box) const;
+
+  // Batch versions of the queries, run on the shared thread pool
+  std::vector<std::vector<int> > intersecting(const std::vector<Line>& lines) const;
+  std::vector<std::vector<int> > within(const std::vector<LatLonBox>& boxes) const;
+private:
+  struct Rect {
+    double min_lat;
+    double max_lat;
+    double min_lon;
+    double max_lon;
+    bool overlaps(const Rect& rect) const {
+      return min_lat <= rect.max_lat and rect.min_lat <= max_lat
+          and min_lon <= rect.max_lon and rect.min_lon <= max_lon;
+    }
+    void extend(const Rect& rect) {
+      min_lat = std::min(min_lat, rect.min_lat);
+      max_lat = std::max(max_lat, rect.max_lat);
+      min_lon = std::min(min_lon, rect.min_lon);
+      max_lon = std::max(max_lon, rect.max_lon);
+    }
+  };
+  struct Node {
+    Rect rect;
+    int first;  // first child node, or first entry for leaves
+    int count;
+    bool leaf;
+  };
+  static int split(const LatLonBox& box, Rect* rects);
+  void search(const Rect* rects, const int n, std::vector<int>* result) const;
+
+  std::vector<Line> _lines;
+  std::vector<Rect> _rects;     // one or two per indexed line
+  std::vector<int> _entries;    // line index of each rect
+  std::vector<Node> _nodes;     // root is the last node
+  int _indexed;                 // number of lines in the tree
+};
+
+// Distance measure of the position queries
+typedef enum {pd_geodesic, pd_rhumb} PositionDistance;
+
+// Position found by a query, by index in the PositionIndex
+struct Neighbour {
+  int index;
+  double distance;
+};
+
+// Static kd-tree over the n-vectors of positions. Working in earth centered
+// coordinates there is no special case for the poles or the antimeridian.
+// Subtrees are pruned with a lower bound of the distance on the ellipsoid
+// derived from the chord to their box; candidates are verified with the
+// geodesic or rhumb line distance on the earth model of the calling thread,
+// solved a leaf of batch_lanes positions at a time. Results are ordered by
+// distance.
+struct PositionIndex {
+  PositionIndex() {}
+  PositionIndex(const std::vector<Position>& positions);
+  // Index n positions given in radians
+  PositionIndex(const int n, const double* lat, const double* lon);
+
+  int size() const {
+    return static_cast<int>(_order.size());
+  }
+  Position operator[](const int i) const {
+    if (i < 0 or i >= size())
+      throw IndexError(i);
+    return Position(_positions[i]);
+  }
+
+  // The k positions nearest to position, or all if there are fewer
+  std::vector<Neighbour> nearest(const Position& position, const int k,
+      const PositionDistance distance = pd_geodesic) const;
+  // The positions within radius meters of position
+  std::vector<Neighbour> within(const Position& position, const double radius,
+      const PositionDistance distance = pd_geodesic) const;
+
+  // Batch versions of the queries, run on the shared thread pool
+  std::vector<std::vector<Neighbour> > nearest(const std::vector<Position>& positions,
+      const int k, const PositionDistance distance = pd_geodesic) const;
+  std::vector<std::vector<Neighbour> > within(const std::vector<Position>& positions,
+      const double radius, const PositionDistance distance = pd_geodesic) const;
+private:
+  struct Node {
+    double min[3];
+    double max[3];
+    int first;  // first point, in tree order
+    int count;
+    int left;   // children, or -1 for leaves
+    int right;
+  };
+  struct Query;
+  void build(const int n, const double* lat, const double* lon);
+  int build_node(const int first, const int count);
+  template <class Visit>
+  void search(const Query& query, Visit& visit) const;
+
+  std::vector<PositionValue> _positions;  // by index
+  std::vector<Cartesian> _points;         // in tree order
+  std::vector<double> _lat;               // in tree order
+  std::vector<double> _lon;
+  std::vector<int> _order;                // index of each point in tree order
+  std::vector<Node> _nodes;               // root first
+};
+
+// Crossing of a line from the first set with one from the second
+struct Crossing {
+  Crossing(): first(0), second(0), position() {}
+  int first;
+  int second;
+  Position position;
+};
+
+// All crossings between two sets of lines, ordered by first and second
+// index. A sweep over latitude pairs up the lines with overlapping bounding
+// boxes, which takes O((n + k) log n) for segments of limited longitude
+// extent.
+extern std::vector<Crossing> crossings(const std::vector<Line>& lines1,
+    const std::vector<Line>& lines2);
+
+// Polygon of rhumb line edges from each vertex to the next and from the last
+// back to the first, for containment tests against a fixed region such as a
+// geofence. Rhumb lines are straight in (longitude, isometric latitude), so
+// containment is decided by counting the edges that cross the meridian of
+// a position north of it, with the isometric latitudes of the vertices
+// computed once on the earth model of the thread that built the polygon.
+// The longitude range of the polygon is split into as many equal bands as
+// it has edges, each listing the edges it overlaps, so a test only looks
+// at the few edges of one band: constant time for polygons whose edges are
+// short compared to their extent, and at worst linear in the edges.
+// Polygons may cross the antimeridian. A polygon whose edges wind around a
+// pole contains the region to the left of its edges, which is the north
+// cap when the edges run east. Vertices must not be poles and edges must
+// not cross each other.
+struct Polygon {
+  Polygon(): _model(get_earth_model()), _north(false) {}
+  Polygon(const std::vector<Position>& vertices);
+  // Polygon of a chain of edges, taking the first position of each
+  Polygon(const std::vector<Line>& edges);
+  // Polygon of n vertices given in radians
+  Polygon(const int n, const double* lat, const double* lon);
+
+  int size() const {
+    return static_cast<int>(_lat.size());
+  }
+  Position operator[](const int i) const {
+    if (i < 0 or i >= size())
+      throw IndexError(i);
+    PositionValue p = {_lat[i], _lon[i]};
+    return Position(p);
+  }
+  const LatLonBox& get_bounding_box() const {
+    return _box;
+  }
+
+  bool contains(const Position& position) const {
+    PositionValue p = position.value();
+    return contains(p.lat, p.lon);
+  }
+  // Containment of a position in radians, first rejected by the bounding box
+  bool contains(const double lat, const double lon) const;
+  // Containment of n positions in radians
+  void contains(const int n, const double* lat, const double* lon, char* inside) const;
+private:
+  // Edge from west to east in (longitude, isometric latitude), with the
+  // longitudes unwrapped to run continuously from the first vertex
+  struct Edge {
+    double x1;
+    double x2;
+    double y1;
+    double slope;
+  };
+  void build(const int n, const double* lat, const double* lon);
+
+  EarthModel* _model;
+  std::vector<double> _lat;
+  std::vector<double> _lon;
+  LatLonBox _box;
+  bool _north;                  // whether the polygon contains the north pole
+  double _min_x;                // unwrapped longitude range of the edges
+  double _max_x;
+  double _band_width;
+  std::vector<int> _bands;      // first entry of each band in _edges, and the end
+  std::vector<Edge> _edges;     // edges overlapping each band
+};
+
+// Containment of n positions in radians in m polygons, written row major to
+// inside[i * m + j]. Each position is tested against the bounding boxes of
+// all polygons, kept contiguous, before the edges of the few polygons whose
+// box contains it. Positions are tested in blocks on the shared thread pool.
+extern void containing(const std::vector<Polygon>& polygons, const int n,
+    const double* lat, const double* lon, char* inside);
+// Indices of the polygons containing each position
+extern std::vector<std::vector<int> > containing(const std::vector<Polygon>& polygons,
+    const std::vector<Position>& positions);
+
+};  // namespace geofun
+
+#endif // __GEOFUN_INDEX_HPP
@@ -0,0 +1,43 @@
+#include "geofun_local.hpp"
+
+namespace geofun {
+
+LocalProjection::LocalProjection(const Position& origin, const Ellipsoid& e)
+{
+  PositionValue p = origin.value();
+  _lat0 = p.lat;
+  _lon0 = p.lon;
+  double sinlat, coslat;
+  sin_cos(_lat0, &sinlat, &coslat);
+  const double w2 = 1 - e.e2 * sqr(sinlat);
+  const double n = e.a / sqrt(w2);
+  _m0 = n * (1 - e.e2) / w2;
+  _m1 = 1.5 * _m0 * e.e2 * sinlat * coslat / w2;
+  _p0 = n * coslat;
+  _p1 = -_m0 * sinlat;
+  _c = 0.5 * n * sinlat * coslat;
+}
+
+void LocalProjection::to_coord(const int n, const double* lat, const double* lon,
+    double* x, double* y) const
+{
+  for (int i = 0; i < n; ++i) {
+    const double dlat = lat[i] - _lat0;
+    const double dlon = angle_pipi(lon[i] - _lon0);
+    x[i] = dlat * (_m0 + _m1 * dlat) + _c * sqr(dlon);
+    y[i] = dlon * (_p0 + _p1 * dlat);
+  }
+}
+
+void LocalProjection::to_position(const int n, const double* x, const double* y,
+    double* lat, double* lon) const
+{
+  for (int i = 0; i < n; ++i) {
+    CoordValue c = {x[i], y[i]};
+    PositionValue p = to_position(c);
+    lat[i] = p.lat;
+    lon[i] = p.lon;
+  }
+}
+
+}  // namespace geofun
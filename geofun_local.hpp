@@ -0,0 +1,80 @@
+#ifndef __GEOFUN_LOCAL_HPP
+#define __GEOFUN_LOCAL_HPP
+
+#include "geofun.hpp"
+
+namespace geofun {
+
+// Projection onto the plane tangent to the ellipsoid at an origin, for many
+// operations in an area around one reference point. The radii of curvature
+// at the origin and their first variation are computed once; mapping a
+// position is then a few multiplications and no transcendental functions.
+// Coords are in meters with x north and y east, like Vector::cartesian(),
+// so Vector().set_cartesian(c2 - c1) gives the azimuth and range between
+// two mapped positions.
+//
+// The mapping agrees with the tangent plane to second order in the distance
+// d from the origin. With R the earth radius, ranges from the origin have a
+// relative error below (d/R)^2 (0.15 + 0.2 tan^2 lat0) and azimuths from
+// the origin an error below as many radians: at 45 degrees latitude 9E-9 at
+// 1 km, 9E-7 at 10 km and 2.2E-5 at 50 km. Ranges between two mapped
+// positions, with d the largest distance of either from the origin, are
+// within (d/R)^2 (0.3 + 0.5 tan^2 lat0). Azimuths between mapped positions
+// are relative to north at the origin; they differ from the true azimuths
+// by the convergence of the meridians, about y tan(lat0) / R radians.
+// to_position inverts to_coord to better than a micrometer within 50 km.
+// The origin must not be a pole.
+struct LocalProjection {
+  LocalProjection(const Position& origin,
+      const Ellipsoid& ellipsoid = get_earth_model()->get_ellipsoid());
+
+  Position get_origin() const {
+    PositionValue p = {_lat0, _lon0};
+    return Position(p);
+  }
+
+  CoordValue to_coord(const PositionValue& p) const {
+    const double dlat = p.lat - _lat0;
+    const double dlon = angle_pipi(p.lon - _lon0);
+    CoordValue result = {
+        dlat * (_m0 + _m1 * dlat) + _c * sqr(dlon),
+        dlon * (_p0 + _p1 * dlat)};
+    return result;
+  }
+  PositionValue to_position(const CoordValue& c) const {
+    // Fixed point iteration on the inverse of to_coord, which contracts by
+    // about the distance over the earth radius per step
+    double dlon = c.y / _p0;
+    double dlat = c.x / _m0;
+    for (int i = 0; i < 4; ++i) {
+      dlat = (c.x - _c * sqr(dlon) - _m1 * sqr(dlat)) / _m0;
+      dlon = c.y / (_p0 + _p1 * dlat);
+    }
+    PositionValue result = {_lat0 + dlat, angle_pipi(_lon0 + dlon)};
+    return result;
+  }
+  Coord to_coord(const Position& position) const {
+    return Coord(to_coord(position.value()));
+  }
+  Position to_position(const Coord& coord) const {
+    return Position(to_position(coord.value()));
+  }
+
+  // Batch versions for n positions in radians
+  void to_coord(const int n, const double* lat, const double* lon,
+      double* x, double* y) const;
+  void to_position(const int n, const double* x, const double* y,
+      double* lat, double* lon) const;
+private:
+  double _lat0;
+  double _lon0;
+  double _m0;  // meridional radius of curvature
+  double _m1;  // half its derivative to latitude
+  double _p0;  // radius of the parallel
+  double _p1;  // its derivative to latitude
+  double _c;   // curvature of the parallel in the tangent plane
+};
+
+};  // namespace geofun
+
+#endif // __GEOFUN_LOCAL_HPP
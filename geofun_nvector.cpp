@@ -0,0 +1,86 @@
+#include "geofun_nvector.hpp"
+
+namespace geofun {
+
+PositionValue ecef_position(const Cartesian& c, const Ellipsoid& e, double* height)
+{
+  const double p = hypot(c.x, c.y);
+  PositionValue result;
+  result.lon = atan2(c.y, c.x);
+  // Iterate on the parametric latitude u, starting from the geocentric one
+  double sinu, cosu;
+  double sinlat = 0, coslat = 1;
+  double u = atan2(c.z * e.a, p * e.b);
+  for (int i = 0; i < 2; ++i) {
+    sin_cos(u, &sinu, &cosu);
+    result.lat = atan2(c.z + e.ep2 * e.b * sinu * sinu * sinu,
+        p - e.e2 * e.a * cosu * cosu * cosu);
+    sin_cos(result.lat, &sinlat, &coslat);
+    u = atan2((1 - e.f) * sinlat, coslat);
+  }
+  if (height) {
+    *height = p * coslat + c.z * sinlat - e.a * sqrt(1 - e.e2 * sqr(sinlat));
+  }
+  return result;
+}
+
+void nvector(const int n, const double* lat, const double* lon,
+    double* x, double* y, double* z)
+{
+  for (int i = 0; i < n; ++i) {
+    double sinlat, coslat, sinlon, coslon;
+    sin_cos(lat[i], &sinlat, &coslat);
+    sin_cos(lon[i], &sinlon, &coslon);
+    x[i] = coslat * coslon;
+    y[i] = coslat * sinlon;
+    z[i] = sinlat;
+  }
+}
+
+void nvector_position(const int n, const double* x, const double* y,
+    const double* z, double* lat, double* lon)
+{
+  for (int i = 0; i < n; ++i) {
+    lat[i] = atan2(z[i], hypot(x[i], y[i]));
+    lon[i] = atan2(y[i], x[i]);
+  }
+}
+
+void ecef(const int n, const double* lat, const double* lon,
+    double* x, double* y, double* z, const Ellipsoid& e)
+{
+  nvector(n, lat, lon, x, y, z);
+  for (int i = 0; i < n; ++i) {
+    const double rn = e.a / sqrt(1 - e.e2 * sqr(z[i]));
+    x[i] *= rn;
+    y[i] *= rn;
+    z[i] *= rn * (1 - e.e2);
+  }
+}
+
+void ecef_position(const int n, const double* x, const double* y,
+    const double* z, double* lat, double* lon, double* height, const Ellipsoid& e)
+{
+  for (int i = 0; i < n; ++i) {
+    Cartesian c = {x[i], y[i], z[i]};
+    PositionValue p = ecef_position(c, e, height ? height + i : 0);
+    lat[i] = p.lat;
+    lon[i] = p.lon;
+  }
+}
+
+void great_circle_distance(const int n,
+    const double* x1, const double* y1, const double* z1,
+    const double* x2, const double* y2, const double* z2,
+    double* distance, const double radius)
+{
+  for (int i = 0; i < n; ++i) {
+    const double cx = y1[i] * z2[i] - z1[i] * y2[i];
+    const double cy = z1[i] * x2[i] - x1[i] * z2[i];
+    const double cz = x1[i] * y2[i] - y1[i] * x2[i];
+    const double d = x1[i] * x2[i] + y1[i] * y2[i] + z1[i] * z2[i];
+    distance[i] = radius * atan2(sqrt(cx * cx + cy * cy + cz * cz), d);
+  }
+}
+
+}  // namespace geofun
@@ -0,0 +1,153 @@
+#ifndef __GEOFUN_NVECTOR_HPP
+#define __GEOFUN_NVECTOR_HPP
+
+#include "geofun.hpp"
+
+namespace geofun {
+
+// Earth centered, earth fixed cartesian coordinates: x towards latitude and
+// longitude 0, y towards longitude 90 degrees east and z towards the north
+// pole. As a unit vector this is the n-vector of a position, the normal to
+// the ellipsoid at its geodetic latitude, which is the same on every earth
+// model. ECEF positions in meters depend on the ellipsoid of the model.
+// Like the other value types it is a plain struct with angles in radians.
+struct Cartesian {
+  double x;
+  double y;
+  double z;
+};
+
+static_assert(std::is_trivially_copyable<Cartesian>::value
+    and std::is_standard_layout<Cartesian>::value
+    and sizeof(Cartesian) == 3 * sizeof(double), "Cartesian is not POD");
+
+inline Cartesian operator+(const Cartesian& c1, const Cartesian& c2)
+{
+  Cartesian result = {c1.x + c2.x, c1.y + c2.y, c1.z + c2.z};
+  return result;
+}
+
+inline Cartesian operator-(const Cartesian& c1, const Cartesian& c2)
+{
+  Cartesian result = {c1.x - c2.x, c1.y - c2.y, c1.z - c2.z};
+  return result;
+}
+
+inline Cartesian operator*(const double value, const Cartesian& c)
+{
+  Cartesian result = {value * c.x, value * c.y, value * c.z};
+  return result;
+}
+
+inline double dot(const Cartesian& c1, const Cartesian& c2)
+{
+  return c1.x * c2.x + c1.y * c2.y + c1.z * c2.z;
+}
+
+inline Cartesian cross(const Cartesian& c1, const Cartesian& c2)
+{
+  Cartesian result = {
+      c1.y * c2.z - c1.z * c2.y,
+      c1.z * c2.x - c1.x * c2.z,
+      c1.x * c2.y - c1.y * c2.x};
+  return result;
+}
+
+inline double norm(const Cartesian& c)
+{
+  return sqrt(dot(c, c));
+}
+
+inline Cartesian normalized(const Cartesian& c)
+{
+  return (1 / norm(c)) * c;
+}
+
+inline Cartesian nvector(const PositionValue& p)
+{
+  double sinlat, coslat, sinlon, coslon;
+  sin_cos(p.lat, &sinlat, &coslat);
+  sin_cos(p.lon, &sinlon, &coslon);
+  Cartesian result = {coslat * coslon, coslat * sinlon, sinlat};
+  return result;
+}
+
+// Position of an n-vector, which need not be of unit length
+inline PositionValue nvector_position(const Cartesian& n)
+{
+  PositionValue result = {atan2(n.z, hypot(n.x, n.y)), atan2(n.y, n.x)};
+  return result;
+}
+
+// ECEF coordinates of a position at a height above the ellipsoid
+inline Cartesian ecef(const PositionValue& p, const Ellipsoid& e, const double height = 0)
+{
+  Cartesian n = nvector(p);
+  // Radius of curvature in the prime vertical
+  const double rn = e.a / sqrt(1 - e.e2 * sqr(n.z));
+  Cartesian result = {(rn + height) * n.x, (rn + height) * n.y,
+      (rn * (1 - e.e2) + height) * n.z};
+  return result;
+}
+
+// Position and optionally height of ECEF coordinates, by Bowring's method.
+// Two iterations leave errors below a micrometer up to the altitude of
+// satellites.
+extern PositionValue ecef_position(const Cartesian& c, const Ellipsoid& e,
+    double* height = 0);
+
+// Angle between two n-vectors. The atan2 of the cross and dot products is
+// accurate for small and nearly antipodal angles alike, unlike acos.
+inline double angle_between(const Cartesian& n1, const Cartesian& n2)
+{
+  return atan2(norm(cross(n1, n2)), dot(n1, n2));
+}
+
+// Great circle distance between n-vectors on a sphere of the mean radius of
+// the ellipsoid of the earth model
+inline double great_circle_distance(const Cartesian& n1, const Cartesian& n2,
+    const double radius = get_earth_model()->get_ellipsoid().r)
+{
+  return radius * angle_between(n1, n2);
+}
+
+// Midpoint of the great circle arc between n-vectors. The midpoint of
+// antipodes is undefined.
+inline Cartesian midpoint(const Cartesian& n1, const Cartesian& n2)
+{
+  return normalized(n1 + n2);
+}
+
+// n-vector at fraction t of the great circle arc from n1 to n2
+inline Cartesian interpolate(const Cartesian& n1, const Cartesian& n2, const double t)
+{
+  const double angle = angle_between(n1, n2);
+  if (angle < 1E-8) {
+    return normalized((1 - t) * n1 + t * n2);
+  }
+  const double s = sin(angle);
+  return (sin((1 - t) * angle) / s) * n1 + (sin(t * angle) / s) * n2;
+}
+
+// Batch conversions between positions and n-vectors or ECEF coordinates for
+// n elements, in structure-of-arrays form like the other batch kernels
+extern void nvector(const int n, const double* lat, const double* lon,
+    double* x, double* y, double* z);
+extern void nvector_position(const int n, const double* x, const double* y,
+    const double* z, double* lat, double* lon);
+extern void ecef(const int n, const double* lat, const double* lon,
+    double* x, double* y, double* z,
+    const Ellipsoid& ellipsoid = get_earth_model()->get_ellipsoid());
+extern void ecef_position(const int n, const double* x, const double* y,
+    const double* z, double* lat, double* lon, double* height = 0,
+    const Ellipsoid& ellipsoid = get_earth_model()->get_ellipsoid());
+
+// Great circle distances between n pairs of n-vectors
+extern void great_circle_distance(const int n,
+    const double* x1, const double* y1, const double* z1,
+    const double* x2, const double* y2, const double* z2,
+    double* distance, const double radius = get_earth_model()->get_ellipsoid().r);
+
+};  // namespace geofun
+
+#endif // __GEOFUN_NVECTOR_HPP
@@ -0,0 +1,150 @@
+#include "geofun_pool.hpp"
+
+namespace geofun {
+
+// Set while a thread executes a pool task, so nested batches run serially
+// instead of waiting on the pool they occupy
+static thread_local bool in_pool_task = false;
+
+ThreadPool::ThreadPool(const int threads):
+  _generation(0), _stop(false), _remaining(0), _task(0)
+{
+  int n = threads > 0 ? threads : static_cast<int>(std::thread::hardware_concurrency());
+  n = std::max(n, 1);
+  for (int i = 0; i < n; ++i) {
+    _workers.push_back(new Worker);
+  }
+  for (int i = 0; i < n - 1; ++i) {
+    _threads.push_back(std::thread(&ThreadPool::loop, this, i));
+  }
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stop = true;
+  }
+  _wake.notify_all();
+  for (size_t i = 0; i < _threads.size(); ++i) {
+    _threads[i].join();
+  }
+  for (size_t i = 0; i < _workers.size(); ++i) {
+    delete _workers[i];
+  }
+}
+
+ThreadPool& ThreadPool::instance()
+{
+  static ThreadPool pool;
+  return pool;
+}
+
+void ThreadPool::run(const int n, const std::function<void(int)>& task)
+{
+  if (n <= 0) {
+    return;
+  }
+  if (_threads.empty() or n == 1 or in_pool_task) {
+    for (int i = 0; i < n; ++i) {
+      task(i);
+    }
+    return;
+  }
+
+  std::lock_guard<std::mutex> run_lock(_run_mutex);
+  _task = &task;
+  _context = get_context();
+  _error = std::exception_ptr();
+  _remaining = n;
+  // Contiguous ranges per worker, so neighbouring tasks tend to run on the
+  // same thread
+  const int workers = size();
+  for (int w = 0; w < workers; ++w) {
+    std::lock_guard<std::mutex> lock(_workers[w]->mutex);
+    for (int i = n * w / workers; i < n * (w + 1) / workers; ++i) {
+      _workers[w]->tasks.push_back(i);
+    }
+  }
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    ++_generation;
+  }
+  _wake.notify_all();
+
+  work(workers - 1);
+
+  std::unique_lock<std::mutex> lock(_mutex);
+  _done.wait(lock, [this] { return _remaining == 0; });
+  if (_error) {
+    std::rethrow_exception(_error);
+  }
+}
+
+bool ThreadPool::pop(const int worker, int* task)
+{
+  Worker& w = *_workers[worker];
+  std::lock_guard<std::mutex> lock(w.mutex);
+  if (w.tasks.empty()) {
+    return false;
+  }
+  *task = w.tasks.front();
+  w.tasks.pop_front();
+  return true;
+}
+
+bool ThreadPool::steal(const int worker, int* task)
+{
+  const int workers = size();
+  for (int i = 1; i < workers; ++i) {
+    Worker& w = *_workers[(worker + i) % workers];
+    std::lock_guard<std::mutex> lock(w.mutex);
+    if (not w.tasks.empty()) {
+      *task = w.tasks.back();
+      w.tasks.pop_back();
+      return true;
+    }
+  }
+  return false;
+}
+
+void ThreadPool::work(const int worker)
+{
+  int task;
+  while (pop(worker, &task) or steal(worker, &task)) {
+    set_context(_context);
+    in_pool_task = true;
+    try {
+      (*_task)(task);
+    }
+    catch (...) {
+      std::lock_guard<std::mutex> lock(_mutex);
+      if (not _error) {
+        _error = std::current_exception();
+      }
+    }
+    in_pool_task = false;
+    if (--_remaining == 0) {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _done.notify_all();
+    }
+  }
+}
+
+void ThreadPool::loop(const int worker)
+{
+  unsigned generation = 0;
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _wake.wait(lock, [&] { return _stop or _generation != generation; });
+      if (_stop) {
+        return;
+      }
+      generation = _generation;
+    }
+    work(worker);
+  }
+}
+
+}  // namespace geofun
@@ -0,0 +1,66 @@
+#ifndef __GEOFUN_POOL_HPP
+#define __GEOFUN_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "geofun.hpp"
+
+namespace geofun {
+
+// Work stealing thread pool for the parallel batch functions. Tasks of a
+// batch are spread over per worker queues; a worker that runs out of tasks
+// steals from the other end of another worker's queue. Tasks run with the
+// context (angle mode, earth model) of the thread that submitted the batch.
+struct ThreadPool {
+  // Pool with the given number of threads including the calling thread. Zero
+  // selects the hardware concurrency.
+  explicit ThreadPool(const int threads = 0);
+  ~ThreadPool();
+
+  // Call task(i) for i in [0, n) and return when all calls are done. The
+  // first exception thrown by a task is rethrown. When called from within a
+  // task, the tasks are run serially.
+  void run(const int n, const std::function<void(int)>& task);
+  int size() const {
+    return static_cast<int>(_workers.size());
+  }
+
+  // Pool shared by the library functions
+  static ThreadPool& instance();
+private:
+  ThreadPool(const ThreadPool&);
+  ThreadPool& operator=(const ThreadPool&);
+
+  struct Worker {
+    std::mutex mutex;
+    std::deque<int> tasks;
+  };
+  bool pop(const int worker, int* task);
+  bool steal(const int worker, int* task);
+  void work(const int worker);
+  void loop(const int worker);
+
+  std::vector<Worker*> _workers;  // the last one is the submitting thread
+  std::vector<std::thread> _threads;
+  std::mutex _run_mutex;
+  std::mutex _mutex;
+  std::condition_variable _wake;
+  std::condition_variable _done;
+  unsigned _generation;
+  bool _stop;
+  std::atomic<int> _remaining;
+  const std::function<void(int)>* _task;
+  Context _context;
+  std::exception_ptr _error;  // first exception thrown by a task
+};
+
+};  // namespace geofun
+
+#endif // __GEOFUN_POOL_HPP
@@ -0,0 +1,302 @@
+#include "geofun_track.hpp"
+#include "geofun_batch.hpp"
+#include "geofun_pool.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <utility>
+
+namespace geofun {
+
+void Track::append(const Position& position)
+{
+  append(position, std::numeric_limits<double>::quiet_NaN());
+}
+
+void Track::append(const Position& position, const double time)
+{
+  PositionValue p = position.value();
+  append(1, &p.lat, &p.lon, &time);
+}
+
+void Track::append(const int n, const double* lat, const double* lon, const double* time)
+{
+  if (n <= 0) {
+    return;
+  }
+  const int first = size();
+  _lat.insert(_lat.end(), lat, lat + n);
+  _lon.insert(_lon.end(), lon, lon + n);
+  if (time) {
+    _time.insert(_time.end(), time, time + n);
+  }
+  else {
+    _time.resize(_time.size() + n, std::numeric_limits<double>::quiet_NaN());
+  }
+  update(first);
+}
+
+void Track::update(const int first)
+{
+  const int n = size();
+  _distance.resize(n);
+  _bearing.resize(std::max(n - 1, 0));
+  if (first == 0 and n > 0) {
+    _distance[0] = 0;
+  }
+  // Legs from fix i - 1 to i for i from begin on, with the lengths written
+  // to the distances and summed up afterwards
+  const int begin = std::max(first, 1);
+  const int legs = n - begin;
+  if (legs <= 0) {
+    return;
+  }
+  const int k = begin - 1;
+  std::vector<double> reverse;
+  if (_legs == tl_geodesic) {
+    reverse.resize(legs);
+    vincenty_inverse(legs, &_lat[k], &_lon[k], &_lat[k + 1], &_lon[k + 1],
+        &_distance[begin], &_bearing[k], &reverse[0], 0, _model->get_ellipsoid());
+  }
+  else {
+    for (int i = begin; i < n; ++i) {
+      _model->rhumb_inverse(_lat[i - 1], _lon[i - 1], _lat[i], _lon[i],
+          &_bearing[i - 1], &_distance[i]);
+    }
+  }
+  for (int i = begin; i < n; ++i) {
+    _distance[i] += _distance[i - 1];
+  }
+
+  // Latitude and longitude are monotonic along rhumb lines, and longitude
+  // along geodesics, so the ends bound the legs except for the vertex of a
+  // geodesic that turns from north to south or back
+  _boxes.resize(n - 1);
+  _min_cos.resize(n - 1);
+  const double f = _model->get_ellipsoid().f;
+  for (int i = k; i < n - 1; ++i) {
+    LatLonBox& box = _boxes[i];
+    const bool eastward = _bearing[i] <= pi;
+    box.min_lat = std::min(_lat[i], _lat[i + 1]);
+    box.max_lat = std::max(_lat[i], _lat[i + 1]);
+    box.min_lon = eastward ? _lon[i] : _lon[i + 1];
+    box.max_lon = eastward ? _lon[i + 1] : _lon[i];
+    // The reverse azimuth points back along the leg, so it heads north
+    // where the leg ends heading south and the other way around
+    const double cosa1 = cos(_bearing[i]);
+    if (_legs == tl_geodesic and cosa1 * cos(reverse[i - k]) > 0) {
+      // Clairaut's relation gives the parametric latitude of the vertex
+      const double sina0 = fabs(cos(atan((1 - f) * tan(_lat[i]))) * sin(_bearing[i]));
+      const double vertex = atan2(sqrt((1 - sina0) * (1 + sina0)), (1 - f) * sina0);
+      if (cosa1 > 0) {
+        box.max_lat = vertex;
+      }
+      else {
+        box.min_lat = -vertex;
+      }
+      // A meridian through the pole jumps half around in longitude
+      if (sina0 < 1E-12) {
+        box.min_lon = -pi;
+        box.max_lon = pi;
+      }
+    }
+    _min_cos[i] = std::min(cos(box.min_lat), cos(box.max_lat));
+  }
+}
+
+PositionValue Track::along(const int leg, const double distance) const
+{
+  PositionValue p = {_lat[leg], _lon[leg]};
+  if (distance <= 0) {
+    return p;
+  }
+  if (_legs == tl_geodesic) {
+    GeodesicLine line(p.lat, p.lon, _bearing[leg], 0, _model->get_ellipsoid());
+    line.position(distance, &p.lat, &p.lon);
+  }
+  else {
+    _model->rhumb_direct(p.lat, p.lon, _bearing[leg], distance, &p.lat, &p.lon);
+  }
+  return p;
+}
+
+Position Track::at_distance(const double distance) const
+{
+  const int n = size();
+  check(0, n);
+  if (n == 1 or distance <= 0) {
+    return (*this)[0];
+  }
+  if (distance >= _distance.back()) {
+    return (*this)[n - 1];
+  }
+  // Last fix at or before distance, which is not the last fix
+  int i = static_cast<int>(std::upper_bound(_distance.begin(), _distance.end(), distance)
+      - _distance.begin()) - 1;
+  return Position(along(i, distance - _distance[i]));
+}
+
+Position Track::at_time(const double time) const
+{
+  const int n = size();
+  check(0, n);
+  if (n == 1 or not (time > _time[0])) {
+    return (*this)[0];
+  }
+  if (time >= _time[n - 1]) {
+    return (*this)[n - 1];
+  }
+  int i = static_cast<int>(std::upper_bound(_time.begin(), _time.end(), time)
+      - _time.begin()) - 1;
+  const double t = (time - _time[i]) / (_time[i + 1] - _time[i]);
+  return Position(along(i, t * (_distance[i + 1] - _distance[i])));
+}
+
+Track Track::slice(const int begin, const int end) const
+{
+  const int n = size();
+  const int b = std::min(std::max(begin < 0 ? begin + n : begin, 0), n);
+  const int e = std::max(std::min(end < 0 ? end + n : end, n), b);
+  Track result(_legs);
+  result._model = _model;
+  result._lat.assign(_lat.begin() + b, _lat.begin() + e);
+  result._lon.assign(_lon.begin() + b, _lon.begin() + e);
+  result._time.assign(_time.begin() + b, _time.begin() + e);
+  result._distance.assign(_distance.begin() + b, _distance.begin() + e);
+  for (size_t i = 0; i < result._distance.size(); ++i) {
+    result._distance[i] -= _distance[b];
+  }
+  if (e > b) {
+    result._bearing.assign(_bearing.begin() + b, _bearing.begin() + e - 1);
+    result._boxes.assign(_boxes.begin() + b, _boxes.begin() + e - 1);
+    result._min_cos.assign(_min_cos.begin() + b, _min_cos.begin() + e - 1);
+  }
+  return result;
+}
+
+// Lower bound of the angle between the normals at a position and at any
+// point of a leg, which is the great circle distance on the unit sphere with
+// geodetic latitudes. The haversine of that distance is at least the sum of
+// its latitude and longitude terms at the nearest edges of the box, with the
+// smallest cosine of latitude in the box, and sin x >= x - x^3 / 6 and
+// asin x >= x keep the bound free of transcendental functions.
+static double leg_angle(const double lat, const double lon, const double coslat,
+    const LatLonBox& box, const double min_cos)
+{
+  const double lat_gap = 0.5 * std::max(0.0, std::max(box.min_lat - lat, lat - box.max_lat));
+  const double east = lon_span(box.min_lon, lon);
+  const double span = lon_span(box.min_lon, box.max_lon);
+  const double lon_gap = east <= span ? 0 : 0.5 * std::min(east - span, two_pi - east);
+  const double s1 = lat_gap * (1 - sqr(lat_gap) / 6);
+  const double s2 = lon_gap * (1 - sqr(lon_gap) / 6);
+  return 2 * sqrt(sqr(s1) + coslat * min_cos * sqr(s2));
+}
+
+void Track::abeam(const int leg, const PositionValue& p, double* along, double* cross) const
+{
+  const Ellipsoid& e = _model->get_ellipsoid();
+  const double length = _distance[leg + 1] - _distance[leg];
+  GeodesicLine line(_lat[leg], _lon[leg], _bearing[leg], length, e);
+  // Move along the leg by the side of the right spherical triangle with the
+  // distance to the position as hypotenuse, until the geodesic to the
+  // position is perpendicular to the leg or the foot is clamped to an end.
+  // Each step reduces the error in the foot by a factor of about the
+  // flattening or the distance over the earth radius.
+  double t = 0;
+  double distance = 0;
+  double angle = 0;
+  for (int i = 0; i < 16; ++i) {
+    PositionValue x = {_lat[leg], _lon[leg]};
+    double azimuth = _bearing[leg];
+    if (t > 0) {
+      if (_legs == tl_geodesic) {
+        line.position(t, &x.lat, &x.lon, &azimuth);
+      }
+      else {
+        _model->rhumb_direct(_lat[leg], _lon[leg], _bearing[leg], t, &x.lat, &x.lon);
+      }
+    }
+    double to_p;
+    vincenty_inverse(x, p, e, &distance, &to_p);
+    angle = to_p - azimuth;
+    const double sigma = distance / e.r;
+    const double step = e.r * atan2(sin(sigma) * cos(angle), cos(sigma));
+    const double next = std::min(std::max(t + step, 0.0), length);
+    if (fabs(next - t) < 1E-4) {
+      break;
+    }
+    t = next;
+  }
+  *along = t;
+  *cross = sin(angle) >= 0 ? distance : -distance;
+}
+
+RouteOffset Track::offset(const PositionValue& p) const
+{
+  const int legs = size() - 1;
+  check(0, legs);
+  // The normal of the ellipsoid turns by at most 1 / (a (1 - e2)) per meter
+  const Ellipsoid& e = _model->get_ellipsoid();
+  const double radius = e.a * (1 - e.e2) * (1 - 1E-9);
+  const double coslat = cos(p.lat);
+  // Visit the legs nearest first from a heap of their bounds, which stops
+  // short of ordering the legs that are pruned
+  typedef std::pair<double, int> Bound;
+  std::vector<Bound> heap(legs);
+  for (int i = 0; i < legs; ++i) {
+    heap[i] = Bound(radius * leg_angle(p.lat, p.lon, coslat, _boxes[i], _min_cos[i]), i);
+  }
+  std::make_heap(heap.begin(), heap.end(), std::greater<Bound>());
+  RouteOffset result = {-1, 0, 0};
+  double nearest = std::numeric_limits<double>::infinity();
+  while (not heap.empty() and heap.front().first <= nearest) {
+    const int i = heap.front().second;
+    std::pop_heap(heap.begin(), heap.end(), std::greater<Bound>());
+    heap.pop_back();
+    double along, cross;
+    abeam(i, p, &along, &cross);
+    if (fabs(cross) < nearest or (fabs(cross) == nearest and i < result.leg)) {
+      nearest = fabs(cross);
+      result.leg = i;
+      result.cross_track = cross;
+      result.along_track = _distance[i] + along;
+    }
+  }
+  return result;
+}
+
+RouteOffset Track::offset(const Position& position) const
+{
+  return offset(position.value());
+}
+
+void Track::offsets(const int n, const double* lat, const double* lon,
+    int* leg, double* cross_track, double* along_track) const
+{
+  check(0, size() - 1);
+  const int block = 64;
+  ThreadPool::instance().run((n + block - 1) / block, [&](const int b) {
+    const int end = std::min(n, (b + 1) * block);
+    for (int i = b * block; i < end; ++i) {
+      PositionValue p = {lat[i], lon[i]};
+      RouteOffset o = offset(p);
+      leg[i] = o.leg;
+      cross_track[i] = o.cross_track;
+      along_track[i] = o.along_track;
+    }
+  });
+}
+
+std::vector<RouteOffset> Track::offsets(const std::vector<Position>& positions) const
+{
+  check(0, size() - 1);
+  std::vector<RouteOffset> result(positions.size());
+  ThreadPool::instance().run(static_cast<int>(positions.size()), [&](const int i) {
+    result[i] = offset(positions[i].value());
+  });
+  return result;
+}
+
+}  // namespace geofun
@@ -0,0 +1,111 @@
+#ifndef __GEOFUN_TRACK_HPP
+#define __GEOFUN_TRACK_HPP
+
+#include <vector>
+
+#include "geofun.hpp"
+#include "geofun_index.hpp"
+
+namespace geofun {
+
+// Kind of the legs between consecutive fixes of a track
+typedef enum {tl_rhumb, tl_geodesic} TrackLegs;
+
+// Position relative to the nearest leg of a track followed as a route
+struct RouteOffset {
+  int leg;
+  // Distance to the nearest point of the leg, positive when the position
+  // lies to the right of the leg
+  double cross_track;
+  // Distance along the track from its first fix to that point
+  double along_track;
+};
+
+// Track of fixes stored as contiguous arrays, with the distance along the
+// track to every fix and the bearing of every leg computed as the fixes are
+// appended. Lookups by distance and time are binary searches. Legs are
+// rhumb lines on the earth model or geodesics on its ellipsoid, with the
+// model of the thread that created the track. Times are in seconds and must
+// not decrease; fixes appended without a time have time NaN.
+struct Track {
+  Track(const TrackLegs legs = tl_rhumb): _legs(legs), _model(get_earth_model()) {}
+
+  void append(const Position& position);
+  void append(const Position& position, const double time);
+  // Append n fixes given in radians. The legs are solved in one batch.
+  void append(const int n, const double* lat, const double* lon, const double* time = 0);
+
+  int size() const {
+    return static_cast<int>(_lat.size());
+  }
+  Position operator[](const int i) const {
+    check(i, size());
+    PositionValue p = {_lat[i], _lon[i]};
+    return Position(p);
+  }
+  double get_time(const int i) const {
+    check(i, size());
+    return _time[i];
+  }
+  // Leg from fix i to fix i + 1 as bearing and length
+  Vector leg(const int i) const {
+    check(i, size() - 1);
+    VectorValue v = {_bearing[i], _distance[i + 1] - _distance[i]};
+    return Vector(v);
+  }
+  // Distance along the track from the first fix to fix i
+  double distance(const int i) const {
+    check(i, size());
+    return _distance[i];
+  }
+  double get_length() const {
+    return _distance.empty() ? 0 : _distance.back();
+  }
+
+  // Position at a distance along the track, or at a time assuming constant
+  // speed between fixes. Both are clamped to the ends of the track.
+  Position at_distance(const double distance) const;
+  Position at_time(const double time) const;
+
+  // Fixes begin up to end as a new track, with distances from fix begin.
+  // The indices are clamped like those of a Python slice.
+  Track slice(const int begin, const int end) const;
+
+  // Offset of a position from the track as a route of Line (tl_rhumb) or
+  // Arc (tl_geodesic) legs. The nearest point of a leg is the foot of the
+  // geodesic from the position that is perpendicular to the leg, or the
+  // nearest end of the leg when that foot lies beyond it; distances to it
+  // are geodesic. Legs are visited by the distance to their bounding box,
+  // and legs whose box lies farther away than the nearest leg so far are
+  // skipped. Throws IndexError when the track has no legs.
+  RouteOffset offset(const Position& position) const;
+  // Offsets of n positions in radians, run on the shared thread pool in
+  // blocks of positions
+  void offsets(const int n, const double* lat, const double* lon,
+      int* leg, double* cross_track, double* along_track) const;
+  std::vector<RouteOffset> offsets(const std::vector<Position>& positions) const;
+private:
+  static void check(const int i, const int n) {
+    if (i < 0 or i >= n)
+      throw IndexError(i);
+  }
+  // Solve the legs ending at fixes first to size() - 1
+  void update(const int first);
+  PositionValue along(const int leg, const double distance) const;
+  RouteOffset offset(const PositionValue& p) const;
+  void abeam(const int leg, const PositionValue& p, double* along, double* cross) const;
+
+  TrackLegs _legs;
+  EarthModel* _model;
+  std::vector<double> _lat;
+  std::vector<double> _lon;
+  std::vector<double> _time;
+  std::vector<double> _distance;  // along the track to each fix
+  std::vector<double> _bearing;   // initial bearing of each leg
+  std::vector<LatLonBox> _boxes;  // bounding box of each leg
+  std::vector<double> _min_cos;   // smallest cosine of latitude in each box
+};
+
+};  // namespace geofun
+
+#endif // __GEOFUN_TRACK_HPP
@@ -8,8 +8,12 @@ from distutils.core import setup, Extension
 
 geofun_module = Extension(
     '_geofun',
-    sources=['geofun.i', 'geofun.cpp'],
+    sources=['geofun.i', 'geofun.cpp', 'geofun_batch.cpp', 'geofun_pool.cpp',
+             'geofun_index.cpp', 'geofun_track.cpp', 'geofun_file.cpp',
+             'geofun_nvector.cpp', 'geofun_local.cpp'],
     swig_opts=['-c++'],
+    extra_compile_args=['-pthread', '-fno-math-errno', '-fno-trapping-math'],
+    extra_link_args=['-pthread'],
 )
 
 setup (
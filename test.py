@@ -26,3 +26,58 @@ print(v2.a, v2.r)
 p3 = Position(0.1, 0.1)
 p3.lat = 0.2
 print(p3.lat, p3.lon)
+try:
+    import numpy
+except ImportError:
+    numpy = None
+if numpy is not None:
+    lat1 = numpy.array([0.8, 0.9])
+    lon1 = numpy.array([0.8, 0.9])
+    lat2 = numpy.array([1.0, 1.0])
+    lon2 = numpy.array([1.0, 1.0])
+    pairs = [(Position(lat1[i], lon1[i]), Position(lat2[i], lon2[i])) for i in range(2)]
+    arcs = [Arc(q1, q2) for q1, q2 in pairs]
+    lines = [Line(q1, q2) for q1, q2 in pairs]
+    def close(values, expected, tolerance):
+        assert numpy.allclose(values, expected, rtol=0, atol=tolerance), (values, expected)
+    d, a, r = vincenty_inverse(lat1, lon1, lat2, lon2)
+    close(d, [arc.v.r for arc in arcs], 1E-6)
+    close(a, [arc.v.a for arc in arcs], 1E-12)
+    close(r, [arc.r.a for arc in arcs], 1E-12)
+    close(distance(lat1, lon1, lat2, lon2), d, 0)
+    close(bearing(lat1, lon1, lat2, lon2), a, 0)
+    lat, lon, r = vincenty_direct(lat1, lon1, a, d)
+    direct = [Arc(q1, arc.v) for (q1, q2), arc in zip(pairs, arcs)]
+    close(lat, [arc.p2.lat for arc in direct], 1E-12)
+    close(lon, [arc.p2.lon for arc in direct], 1E-12)
+    close(r, [arc.r.a for arc in direct], 1E-12)
+    matrix = distance_matrix(lat1, lon1, lat2, lon2)
+    assert matrix.shape == (2, 2)
+    close(matrix, [[Arc(pairs[i][0], pairs[j][1]).v.r for j in range(2)] for i in range(2)], 1E-6)
+    a, r = rhumb_inverse(lat1, lon1, lat2, lon2)
+    close(a, [line.v.a for line in lines], 1E-12)
+    close(r, [line.v.r for line in lines], 1E-6)
+    lat, lon = rhumb_direct(lat1, lon1, a, r)
+    close(lat, [(q1 + line.v).lat for (q1, q2), line in zip(pairs, lines)], 1E-12)
+    close(lon, [(q1 + line.v).lon for (q1, q2), line in zip(pairs, lines)], 1E-12)
+    times = numpy.array([0.0, 60.0])
+    writer = FileWriter('test.tmp', fk_track)
+    writer.write_arrays(lat1, lon1, times)
+    writer.close()
+    track = MappedFile('test.tmp')
+    assert len(track) == 2
+    close(track.column(0), lat1, 0)
+    close(track.column(1), lon1, 0)
+    close(track.column(2), times, 0)
+    close(distance(*(track.chunks[0][:2] + (lat2, lon2))), d, 0)
+    import os
+    os.remove('test.tmp')
+    index = position_index(numpy.array([0.79, 0.95, 1.0]), numpy.array([0.8, 0.9, 1.0]))
+    found, d = index.nearest(lat1, lon1, 2)
+    assert found.tolist() == [[0, 1], [1, 2]]
+    assert abs(d[0, 0] - Arc(p1, index[0]).v.r) < 1E-6
+    offsets, found, d = index.within(lat1, lon1, 100E3)
+    assert offsets.tolist() == [0, 1, 1] and found.tolist() == [0]
+    square = polygon([0.75, 0.75, 0.85, 0.85], [0.75, 0.85, 0.85, 0.75])
+    assert square.contains(p1) and not square.contains(p2)
+    assert containing([square, Polygon()], lat1, lon1).tolist() == [[True, False], [False, False]]
@@ -4,8 +4,22 @@
 #include <cppunit/extensions/HelperMacros.h>
 
 #include <iostream>
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include <thread>
+#include <cstdio>
+#include <limits>
 
 #include "geofun.hpp"
+#include "geofun_batch.hpp"
+#include "geofun_pool.hpp"
+#include "geofun_index.hpp"
+#include "geofun_track.hpp"
+#include "geofun_file.hpp"
+#include "geofun_compact.hpp"
+#include "geofun_nvector.hpp"
+#include "geofun_local.hpp"
 
 using namespace geofun;
 using namespace std;
@@ -29,6 +43,11 @@ class VectorPositionTest : public CppUnit::TestFixture {
     CPPUNIT_ASSERT_DOUBLES_EQUAL(0, angle_diff(pi - 1E-13, -pi), 1E-12);
     CPPUNIT_ASSERT_DOUBLES_EQUAL(0, angle_diff(-pi, pi), 1E-12);
     CPPUNIT_ASSERT_DOUBLES_EQUAL(0, angle_diff(pi, -pi), 1E-12);
+    // Many turns in one step
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(1, angle_pipi(1 + 1000000 * two_pi), 1E-8);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(two_pi - 1, angle_2pi(-1 - 1000000 * two_pi), 1E-8);
+    CPPUNIT_ASSERT(angle_pipi(pi) == -pi);
+    CPPUNIT_ASSERT(angle_2pi(-1E-20) < two_pi);
   }
   void testOperators() {
     Position p1(0.8, 0.8); // 45.8366236
@@ -82,12 +101,55 @@ class VectorPositionTest : public CppUnit::TestFixture {
     CPPUNIT_ASSERT_DOUBLES_EQUAL(c1.dot(c2), dot, 1E-12);
     CPPUNIT_ASSERT_DOUBLES_EQUAL(c1.cross(c2), cross, 1E-12);
   }
+  void testValues() {
+    std::vector<PositionValue> track(3);
+    CPPUNIT_ASSERT(sizeof(PositionValue) * 3 ==
+        (char*)(&track[2] + 1) - (char*)&track[0]);
+    PositionValue p1 = {0.8, 0.8};
+    PositionValue p2 = {1.0, 1.0};
+    memcpy(&track[0], &p1, sizeof(p1));
+    track[1] = p2;
+    VectorValue v = track[1] - track[0];
+    Vector v1 = Position(1.0, 1.0) - Position(0.8, 0.8);
+    CPPUNIT_ASSERT(Vector(v) == v1);
+    track[2] = track[0] + v;
+    CPPUNIT_ASSERT(Position(track[2]) == Position(0.8, 0.8) + v1);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(1.0, Position(track[2]).get_lat(), 1E-5);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(v.a, v1.value().a, 1E-15);
+    CoordValue c = cartesian(v);
+    CPPUNIT_ASSERT(Coord(c) == v1.cartesian());
+    CPPUNIT_ASSERT(Vector(polar(c)) == v1);
+  }
+  void testStaticEarthModel() {
+    double lat, lon, a, r;
+    Position p1(0.8, 0.8);
+    Position p2(1.0, 1.0);
+    Vector v = p2 - p1;
+    rhumb_inverse<WGS84>(0.8, 0.8, 1.0, 1.0, &a, &r);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(v.get_a(), a, 1E-12);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(v.get_r(), r, 1E-6);
+    rhumb_direct<WGS84>(0.8, 0.8, a, r, &lat, &lon);
+    Position p3 = p1 + v;
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(p3.get_lat(), lat, 1E-12);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(p3.get_lon(), lon, 1E-12);
+    set_earth_model("spherical");
+    v = p2 - p1;
+    p3 = p1 + v;
+    set_earth_model("wgs84");
+    rhumb_inverse<Sphere>(0.8, 0.8, 1.0, 1.0, &a, &r);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(v.get_r(), r, 1E-6);
+    rhumb_direct<Sphere>(0.8, 0.8, a, r, &lat, &lon);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(p3.get_lat(), lat, 1E-12);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(p3.get_lon(), lon, 1E-12);
+  }
 public:
   CPPUNIT_TEST_SUITE(VectorPositionTest);
   CPPUNIT_TEST(testNormAngle);
   CPPUNIT_TEST(testOperators);
   CPPUNIT_TEST(testDivisionByZero);
   CPPUNIT_TEST(testDotCross);
+  CPPUNIT_TEST(testValues);
+  CPPUNIT_TEST(testStaticEarthModel);
   CPPUNIT_TEST_SUITE_END();
 };
 
@@ -110,18 +172,45 @@ class LineTest : public CppUnit::TestFixture {
     Position x5 = l4.intersection(l6);
     Position x6 = l4.intersection(l7);
     CPPUNIT_ASSERT_DOUBLES_EQUAL(pi - 0.05, x4.get_lon(), 1E-5);
-    CPPUNIT_ASSERT_DOUBLES_EQUAL(pi, x5.get_lon(), 1E-5);
+    // Exactly on the antimeridian, which may come out as either side
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(0, angle_diff(pi, x5.get_lon()), 1E-5);
     CPPUNIT_ASSERT_DOUBLES_EQUAL(-pi, x6.get_lon(), 1E-5);
   }
+  void testIntersectionAccuracy() {
+    // The crossing lies on both rhumb lines, which are straight in longitude
+    // and isometric latitude
+    Line l1(Position(0.7, 0.1), Position(0.72, 0.13));
+    Line l2(Position(0.73, 0.1), Position(0.69, 0.14));
+    Position x = l1.intersection(l2);
+    const Ellipsoid& e = wgs84_ellipsoid;
+    double y = e.isometric_latitude(x.get_lat());
+    CPPUNIT_ASSERT_DOUBLES_EQUAL((x.get_lon() - 0.1) / 0.03,
+        (y - e.isometric_latitude(0.7)) / (e.isometric_latitude(0.72) - e.isometric_latitude(0.7)), 1E-12);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL((x.get_lon() - 0.1) / 0.04,
+        (y - e.isometric_latitude(0.73)) / (e.isometric_latitude(0.69) - e.isometric_latitude(0.73)), 1E-12);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(0.7, e.geodetic_latitude(e.isometric_latitude(0.7)), 1E-15);
+    double lat, lon;
+    CPPUNIT_ASSERT(rhumb_intersection(0.7, 0.1, 0.72, 0.13, 0.73, 0.1, 0.69, 0.14, &lat, &lon));
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(x.get_lat(), lat, 1E-15);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(x.get_lon(), lon, 1E-15);
+    // Extended lines cross outside the segments; parallel lines don't cross
+    CPPUNIT_ASSERT(not rhumb_intersection(0.7, 0.1, 0.71, 0.11, 0.73, 0.1, 0.72, 0.11, &lat, &lon));
+    CPPUNIT_ASSERT(not rhumb_intersection(0.7, 0.1, 0.7, 0.2, 0.8, 0.1, 0.8, 0.2, &lat, &lon));
+    // The same crossing shifted across the antimeridian
+    CPPUNIT_ASSERT(rhumb_intersection(0.7, pi - 0.01, 0.72, -pi + 0.02, 0.73, pi - 0.01, 0.69, -pi + 0.03,
+        &lat, &lon));
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(x.get_lat(), lat, 1E-12);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(x.get_lon() - 0.11 + pi, angle_2pi(lon), 1E-12);
+  }
   void testLength() {
     Line l1(Position(1.0, 0.9), Position(0.9, 1.0));
-    CPPUNIT_ASSERT_DOUBLES_EQUAL(737866.68517, l1.get_length(), 1E-5);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(737865.64189, l1.get_length(), 1E-5);
     set_angle_mode("degrees");
     try {
       Line l2(Position(rad_to_deg(1.0), rad_to_deg(0.9)), Position(rad_to_deg(0.9), rad_to_deg(1.0)));
-      CPPUNIT_ASSERT_DOUBLES_EQUAL(737866.68517, l2.get_length(), 1E-5);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(737865.64189, l2.get_length(), 1E-5);
       set_angle_mode("radians");
-      CPPUNIT_ASSERT_DOUBLES_EQUAL(737866.68517, l2.get_length(), 1E-5);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(737865.64189, l2.get_length(), 1E-5);
     }
     catch(...) {
       set_angle_mode("radians");
@@ -131,6 +220,7 @@ class LineTest : public CppUnit::TestFixture {
 public:
   CPPUNIT_TEST_SUITE(LineTest);
   CPPUNIT_TEST(testIntersection);
+  CPPUNIT_TEST(testIntersectionAccuracy);
   CPPUNIT_TEST(testLength);
   CPPUNIT_TEST_SUITE_END();
 };
@@ -150,9 +240,1336 @@ class ArcTest : public CppUnit::TestFixture {
 
     CPPUNIT_ASSERT(d.get_r() < 10);
   }
+  void testBounds() {
+    // Arc bulging north of both ends, eastward across the antimeridian
+    Arc arc(Position(0.6, 2.8), Position(0.7, -2.5));
+    double top = -pi;
+    for (int i = 0; i <= 1000; ++i) {
+      Arc part(arc.get_p1(), Vector(arc.get_v().get_a(), arc.get_v().get_r() * i / 1000));
+      top = std::max(top, part.get_p2().get_lat());
+    }
+    CPPUNIT_ASSERT(top > 0.72);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(top, arc.max_lat(), 1E-7);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(0.6, arc.min_lat(), 1E-12);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(2.8, arc.min_lon(), 1E-12);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(-2.5, arc.max_lon(), 1E-12);
+    // The bounds survive copying
+    Arc copy(arc);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(arc.max_lat(), copy.max_lat(), 1E-12);
+    // Southward arc in the southern hemisphere passes the southern vertex
+    Arc south(Position(-0.7, -2.5), Position(-0.6, 2.8));
+    CPPUNIT_ASSERT(south.min_lat() < -0.72);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(-0.6, south.max_lat(), 1E-12);
+    // Over the pole
+    Arc polar(Position(1.3, 0.1), Position(1.4, pi - 0.1 + 0.2));
+    CPPUNIT_ASSERT(polar.max_lat() > 1.4);
+  }
+  void testIntersection() {
+    Arc arc1(Position(0.1, 3.0), Position(0.4, -2.9));
+    Arc arc2(Position(0.4, 3.0), Position(0.05, -3.0));
+    CPPUNIT_ASSERT(arc1.intersects(arc2));
+    Position x = arc1.intersection(arc2);
+    // On both arcs: the legs to the ends add up to the arc lengths
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(arc1.get_v().get_r(),
+        Arc(arc1.get_p1(), x).get_v().get_r() + Arc(x, arc1.get_p2()).get_v().get_r(), 1E-3);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(arc2.get_v().get_r(),
+        Arc(arc2.get_p1(), x).get_v().get_r() + Arc(x, arc2.get_p2()).get_v().get_r(), 1E-3);
+    Position y = arc2.intersection(arc1);
+    CPPUNIT_ASSERT((x - y).get_r() < 1E-3);
+
+    Line line(Position(0.4, 3.0), Position(0.05, -3.0));
+    CPPUNIT_ASSERT(arc1.intersects(line));
+    Position z = arc1.intersection(line);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(arc1.get_v().get_r(),
+        Arc(arc1.get_p1(), z).get_v().get_r() + Arc(z, arc1.get_p2()).get_v().get_r(), 1E-3);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(line.get_v().get_a(), Line(line.get_p1(), z).get_v().get_a(), 1E-5);
+
+    // Arcs that miss each other, within and out of each other's bounds
+    Arc arc3(Position(0.3, 3.0), Position(0.5, -3.1));
+    CPPUNIT_ASSERT(not arc1.intersects(arc3));
+    Arc arc4(Position(-0.5, 1.0), Position(-0.4, 1.2));
+    CPPUNIT_ASSERT(not arc1.intersects(arc4));
+    CPPUNIT_ASSERT(not arc1.intersects(Line(Position(0.3, 3.0), Position(0.5, -3.1))));
+  }
+  void testFallback() {
+    // Nearly antipodal, where the Vincenty iteration doesn't converge
+    Position p1(0.3, 0.1);
+    Position p2(-0.3, 0.1 + pi - 1E-4);
+    Arc arc(p1, p2);
+    CPPUNIT_ASSERT_EQUAL(vs_fallback, arc.get_status());
+    Arc direct(p1, arc.get_v());
+    CPPUNIT_ASSERT_EQUAL(vs_converged, direct.get_status());
+    CPPUNIT_ASSERT((direct.get_p2() - p2).get_r() < 1E-3);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(arc.get_r().get_a(), direct.get_r().get_a(), 1E-9);
+    // Coincident points and points on the equator yield NaN in Vincenty
+    Arc point(p1, p1);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(0, point.get_v().get_r(), 1E-9);
+    Arc equator(Position(0, 0.5), Position(0, -0.5));
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(wgs84_ellipsoid.a, equator.get_v().get_r(), 1E-6);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(1.5 * pi, equator.get_v().get_a(), 1E-12);
+    // Batch lanes fall back as well
+    double lat1[] = {0.3, 0.3, 0, 0.5};
+    double lon1[] = {0.1, 0.1, 0.5, 0.2};
+    double lat2[] = {-0.3, 0.3, 0, 0.6};
+    double lon2[] = {0.1 + pi - 1E-4, 0.1, -0.5, 0.3};
+    double distance[4], azimuth[4], reverse_azimuth[4];
+    VincentyStatus status[4];
+    vincenty_inverse(4, lat1, lon1, lat2, lon2, distance, azimuth, reverse_azimuth, status);
+    for (int i = 0; i < 4; ++i) {
+      Arc arc(Position(lat1[i], lon1[i]), Position(lat2[i], lon2[i]));
+      CPPUNIT_ASSERT_EQUAL(arc.get_status(), status[i]);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(arc.get_v().get_r(), distance[i], 1E-6);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(arc.get_v().get_a(), azimuth[i], 1E-12);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(arc.get_r().get_a(), reverse_azimuth[i], 1E-12);
+    }
+    CPPUNIT_ASSERT_EQUAL(vs_converged, status[3]);
+  }
+  void testTolerance() {
+    Position p1(-0.7, 0.1);
+    Position p2(0.6, 2.9);
+    Context fine;
+    fine.vincenty_tolerance = 1E-12;
+    Context coarse;
+    coarse.vincenty_tolerance = 1E-5;
+    double exact, approximate;
+    {
+      ScopedContext scoped(fine);
+      exact = Arc(p1, p2).get_v().get_r();
+    }
+    {
+      ScopedContext scoped(coarse);
+      approximate = Arc(p1, p2).get_v().get_r();
+    }
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(default_vincenty_tolerance, get_vincenty_tolerance(), 0);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(exact, Arc(p1, p2).get_v().get_r(), 1);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(exact, approximate, 100);
+    CPPUNIT_ASSERT(exact != approximate);
+  }
+  void testFastMath() {
+    for (double x = -20; x < 20; x += 0.001) {
+      double s, c;
+      fast_sin_cos(x, &s, &c);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(sin(x), s, 2E-9);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(cos(x), c, 2E-9);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(atan2(s, c), fast_atan2(s, c), 5E-10);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(atan2(3 * s, c), fast_atan2(3 * s, c), 5E-10);
+    }
+    CPPUNIT_ASSERT(fast_atan2(0, 0) == 0);
+    CPPUNIT_ASSERT(fast_atan2(-0.0, -1) == -pi);
+
+    Position p1(0.8, 0.8);
+    Position p2(-0.3, 2.0);
+    Arc exact(p1, p2);
+    Arc exact_direct(p1, Vector(1.0, 5E6));
+    set_math_precision(mp_fast);
+    Arc fast(p1, p2);
+    Arc fast_direct(p1, Vector(1.0, 5E6));
+    set_math_precision(mp_exact);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(exact.get_v().get_r(), fast.get_v().get_r(), 1E-2);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(exact.get_v().get_a(), fast.get_v().get_a(), 1E-8);
+    CPPUNIT_ASSERT((exact_direct.get_p2() - fast_direct.get_p2()).get_r() < 1E-2);
+  }
 public:
   CPPUNIT_TEST_SUITE(ArcTest);
   CPPUNIT_TEST(testDirectInverse);
+  CPPUNIT_TEST(testBounds);
+  CPPUNIT_TEST(testIntersection);
+  CPPUNIT_TEST(testFallback);
+  CPPUNIT_TEST(testTolerance);
+  CPPUNIT_TEST(testFastMath);
+  CPPUNIT_TEST_SUITE_END();
+};
+
+class ContextTest : public CppUnit::TestFixture {
+  static void degrees_worker(double* lat) {
+    ScopedContext context(Context("degrees", "spherical"));
+    for (int i = 0; i < 10000; ++i) {
+      Position p(45.0, 10.0);
+      *lat = p.get_lat();
+    }
+  }
+  void testThreads() {
+    double degrees_lat = 0;
+    double radians_lat = 0;
+    std::thread worker(degrees_worker, &degrees_lat);
+    for (int i = 0; i < 10000; ++i) {
+      Position p(0.5, 0.1);
+      radians_lat = p.get_lat();
+    }
+    worker.join();
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(45.0, degrees_lat, 1E-12);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(0.5, radians_lat, 1E-12);
+    CPPUNIT_ASSERT(angle_mode == am_radians);
+    CPPUNIT_ASSERT(get_earth_model()->get_ellipsoid().f > 0);
+  }
+  void testScopedContext() {
+    {
+      ScopedContext context(Context("degrees", "wgs84"));
+      CPPUNIT_ASSERT(angle_mode == am_degrees);
+    }
+    CPPUNIT_ASSERT(angle_mode == am_radians);
+    CPPUNIT_ASSERT_THROW(Context("grads", "wgs84"), AngleModeError);
+    CPPUNIT_ASSERT_THROW(Context("radians", "flat"), EarthModelError);
+  }
+  void testUnits() {
+    Position p1(45.0, 10.0, Degrees());
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(deg_to_rad(45.0), p1.get_lat(), 1E-15);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(10.0, p1.get_lon<Degrees>(), 1E-12);
+    Vector v(90.0, 1000, Degrees());
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(half_pi, v.get_a<Radians>(), 1E-15);
+    set_angle_mode("degrees");
+    // Unaffected by the angle mode
+    Position p2(0.5, 0.1, Radians());
+    double lat = p2.get_lat<Radians>();
+    set_angle_mode("radians");
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(0.5, lat, 1E-15);
+  }
+public:
+  CPPUNIT_TEST_SUITE(ContextTest);
+  CPPUNIT_TEST(testThreads);
+  CPPUNIT_TEST(testScopedContext);
+  CPPUNIT_TEST(testUnits);
+  CPPUNIT_TEST_SUITE_END();
+};
+
+class PoolTest : public CppUnit::TestFixture {
+  void testRun() {
+    ThreadPool pool(4);
+    const int n = 1000;
+    std::vector<int> done(n, 0);
+    std::vector<double> lat(n, 0);
+    set_angle_mode("degrees");
+    pool.run(n, [&](const int i) {
+      // Nested batches run serially
+      pool.run(2, [&](const int j) {
+        done[i] += j + 1;
+      });
+      lat[i] = Position(45.0, 0).get_lat<Radians>();
+    });
+    set_angle_mode("radians");
+    for (int i = 0; i < n; ++i) {
+      CPPUNIT_ASSERT_EQUAL(3, done[i]);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(deg_to_rad(45.0), lat[i], 1E-15);
+    }
+  }
+  void testException() {
+    ThreadPool pool(3);
+    CPPUNIT_ASSERT_THROW(pool.run(100, [](const int i) {
+      if (i == 42)
+        throw IndexError(i);
+    }), IndexError);
+    int count = 0;
+    std::mutex mutex;
+    pool.run(10, [&](const int) {
+      std::lock_guard<std::mutex> lock(mutex);
+      ++count;
+    });
+    CPPUNIT_ASSERT_EQUAL(10, count);
+  }
+public:
+  CPPUNIT_TEST_SUITE(PoolTest);
+  CPPUNIT_TEST(testRun);
+  CPPUNIT_TEST(testException);
+  CPPUNIT_TEST_SUITE_END();
+};
+
+class EllipsoidTest : public CppUnit::TestFixture {
+  void testConstants() {
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(6356752.314140, grs80_ellipsoid.b, 1E-6);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(1 / 297.0, international1924_ellipsoid.f, 1E-15);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(f, wgs84_ellipsoid.f, 1E-15);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL((sqa - sqb) / sqb, wgs84_ellipsoid.ep2, 1E-15);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(0, sphere_ellipsoid.f, 1E-15);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(0, sphere_ellipsoid.ep2, 1E-15);
+  }
+  void testModels() {
+    EllipsoidModel custom(wgs84_ellipsoid);
+    Coord d1 = custom.cartesian_deltas(0.8);
+    Coord d2 = WGS84().cartesian_deltas(0.8);
+    CPPUNIT_ASSERT(d1 == d2);
+    EllipsoidModel local_sphere(Ellipsoid(r, r));
+    d1 = local_sphere.cartesian_deltas(0.8);
+    d2 = Sphere().cartesian_deltas(0.8);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(d2.get_x(), d1.get_x(), 1E-8);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(d2.get_y(), d1.get_y(), 1E-8);
+  }
+  void testArcs() {
+    Position p1(0.8, 0.8);
+    Position p2(1.0, 1.0);
+    double wgs84_length = Arc(p1, p2).get_v().get_r();
+    set_earth_model("spherical");
+    double sphere_length = Arc(p1, p2).get_v().get_r();
+    set_earth_model("grs80");
+    double grs80_length = Arc(p1, p2).get_v().get_r();
+    set_earth_model("wgs84");
+    // Great circle distance
+    double sigma = acos(sin(0.8) * sin(1.0) + cos(0.8) * cos(1.0) * cos(0.2));
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(r * sigma, sphere_length, 1E-6);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(wgs84_length, grs80_length, 0.1);
+    CPPUNIT_ASSERT(wgs84_length != grs80_length);
+
+    // Arcs answer on the model they were solved on
+    set_earth_model("spherical");
+    Arc a1(Position(0.8, 0.0), Position(0.8, 1.0));
+    Arc a2(Position(0.7, 0.5), Position(1.0, 0.6));
+    double max_lat = a1.max_lat();
+    CPPUNIT_ASSERT(a1.intersects(a2));
+    Position x = a1.intersection(a2);
+    set_earth_model("wgs84");
+    Arc copy(a1);
+    Arc assigned;
+    assigned = a1;
+    CPPUNIT_ASSERT_EQUAL(max_lat, copy.max_lat());
+    CPPUNIT_ASSERT_EQUAL(max_lat, assigned.max_lat());
+    CPPUNIT_ASSERT(Arc(Position(0.8, 0.0), Position(0.8, 1.0)).max_lat() != max_lat);
+    Position y = copy.intersection(a2);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(x.get_lat(), y.get_lat(), 1E-12);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(x.get_lon(), y.get_lon(), 1E-12);
+    assigned.set_p1(p1);
+    assigned.set_p2(p2);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(sphere_length, assigned.get_v().get_r(), 1E-6);
+  }
+  void testRhumb() {
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(r * 0.7, sphere_ellipsoid.meridian_arc(0.7), 1E-8);
+    for (double lat = -1.5; lat <= 1.5; lat += 0.1) {
+      double arc = wgs84_ellipsoid.meridian_arc(lat);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(lat, wgs84_ellipsoid.meridian_latitude(arc), 1E-15);
+    }
+
+    // Closed form on the sphere
+    double azimuth, range;
+    rhumb_inverse<Sphere>(0.2, 0.3, 0.9, 1.1, &azimuth, &range);
+    double expected = atan2(0.8, asinh(tan(0.9)) - asinh(tan(0.2)));
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(expected, azimuth, 1E-14);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(r * 0.7 / cos(expected), range, 1E-6);
+
+    // Many short steps end where one long step does
+    Position p1(1.0, 0.9);
+    Position p2(0.9, 1.0);
+    Vector v = p2 - p1;
+    Vector step(v.get_a(), v.get_r() / 10000);
+    Position p = p1;
+    for (int i = 0; i < 10000; ++i) {
+      p += step;
+    }
+    CPPUNIT_ASSERT((p - p2).get_r() < 1E-5);
+
+    // Along a parallel
+    double lat2, lon2;
+    rhumb_direct<WGS84>(0.6, 3.1, pi / 2, 1000, &lat2, &lon2);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(0.6, lat2, 1E-15);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(1000 / wgs84_ellipsoid.parallel_radius(0.6),
+        angle_diff(lon2, 3.1), 1E-15);
+    rhumb_inverse<WGS84>(0.6, 3.1, lat2, lon2, &azimuth, &range);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(pi / 2, azimuth, 1E-12);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(1000, range, 1E-8);
+
+    // Over the pole along a meridian
+    double quarter = wgs84_ellipsoid.meridian_arc(pi / 2);
+    rhumb_direct<WGS84>(1.5, 0.2, 0, 2 * (quarter - wgs84_ellipsoid.meridian_arc(1.5)),
+        &lat2, &lon2);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(1.5, lat2, 1E-12);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(0.2 - pi, lon2, 1E-12);
+  }
+  void testTable() {
+    TableEarthModel table(wgs84_ellipsoid);
+    WGS84 exact;
+    for (double lat = -1.55; lat <= 1.55; lat += 0.01) {
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(wgs84_ellipsoid.meridian_arc(lat), table.meridian_arc(lat), 1E-7);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(lat, table.meridian_latitude(wgs84_ellipsoid.meridian_arc(lat)), 1E-14);
+      Coord d1 = exact.cartesian_deltas(lat);
+      Coord d2 = table.cartesian_deltas(lat);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(d1.get_x(), d2.get_x(), 1E-8 * d1.get_x());
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(d1.get_y(), d2.get_y(), 1E-8 * d1.get_y() + 1E-7);
+    }
+
+    // Within the documented bound of the exact model, on either side of
+    // the isometric latitude limit
+    const double lats[] = {0.0, 0.7, -1.2, 1.39, 1.4, -1.45};
+    for (int i = 0; i < 6; ++i) {
+      for (double range = 1; range < 1E6; range *= 7) {
+        double azimuth = 0.3 + range * 1E-6;
+        double lat1, lon1, lat2, lon2, azimuth2, range2;
+        exact.rhumb_direct(lats[i], 0.5, azimuth, range, &lat1, &lon1);
+        table.rhumb_direct(lats[i], 0.5, azimuth, range, &lat2, &lon2);
+        exact.rhumb_inverse(lat1, lon1, lat2, lon2, &azimuth2, &range2);
+        CPPUNIT_ASSERT(range2 < 1E-8 * range + 1E-7);
+        table.rhumb_inverse(lats[i], 0.5, lat1, lon1, &azimuth2, &range2);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(range, range2, 1E-8 * range + 1E-7);
+      }
+    }
+
+    set_earth_model("wgs84_table");
+    Vector v = Position(0.9, 1.0) - Position(1.0, 0.9);
+    set_earth_model("wgs84");
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(737865.64189, v.get_r(), 1E-2);
+  }
+public:
+  CPPUNIT_TEST_SUITE(EllipsoidTest);
+  CPPUNIT_TEST(testConstants);
+  CPPUNIT_TEST(testModels);
+  CPPUNIT_TEST(testArcs);
+  CPPUNIT_TEST(testRhumb);
+  CPPUNIT_TEST(testTable);
+  CPPUNIT_TEST_SUITE_END();
+};
+
+class BatchTest : public CppUnit::TestFixture {
+  void testVincentyInverse() {
+    // More pairs than a single block of lanes, with a partial last block
+    const int n = 2 * batch_lanes + 3;
+    double lat1[n], lon1[n], lat2[n], lon2[n];
+    double distance[n], azimuth[n], reverse_azimuth[n];
+    for (int i = 0; i < n; ++i) {
+      lat1[i] = -1.2 + 0.11 * i;
+      lon1[i] = pi - 0.3 + 0.05 * i;
+      lat2[i] = 1.0 - 0.07 * i;
+      lon2[i] = angle_pipi(lon1[i] + 0.9 - 0.13 * i);
+    }
+    vincenty_inverse(n, lat1, lon1, lat2, lon2, distance, azimuth, reverse_azimuth);
+    for (int i = 0; i < n; ++i) {
+      Arc arc(Position(lat1[i], lon1[i]), Position(lat2[i], lon2[i]));
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(arc.get_v().get_r(), distance[i], 1E-6);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(arc.get_v().get_a(), azimuth[i], 1E-12);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(arc.get_r().get_a(), reverse_azimuth[i], 1E-12);
+      // The scalar version solves single pairs the way Arc does
+      PositionValue p1 = {lat1[i], lon1[i]};
+      PositionValue p2 = {lat2[i], lon2[i]};
+      double d, a, r;
+      CPPUNIT_ASSERT_EQUAL(arc.get_status(),
+          vincenty_inverse(p1, p2, wgs84_ellipsoid, &d, &a, &r));
+      CPPUNIT_ASSERT_EQUAL(arc.get_v().get_r(), d);
+      CPPUNIT_ASSERT_EQUAL(arc.get_v().get_a(), a);
+      CPPUNIT_ASSERT_EQUAL(arc.get_r().get_a(), r);
+    }
+  }
+  void testVincentyDirect() {
+    const int n = 3 * batch_lanes + 5;
+    double lat1[n], lon1[n], azimuth[n], range[n];
+    double lat2[n], lon2[n], reverse_azimuth[n];
+    for (int i = 0; i < n; ++i) {
+      lat1[i] = -1.3 + 0.09 * i;
+      lon1[i] = pi - 0.2 + 0.03 * i;
+      // Groups of vectors with the same azimuth
+      azimuth[i] = 0.4 * (i / 4);
+      range[i] = 1E3 + 1E5 * i;
+    }
+    vincenty_direct(n, lat1, lon1, azimuth, range, lat2, lon2, reverse_azimuth);
+    for (int i = 0; i < n; ++i) {
+      Arc arc(Position(lat1[i], lon1[i]), Vector(azimuth[i], range[i]));
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(arc.get_p2().get_lat(), lat2[i], 1E-12);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(arc.get_p2().get_lon(), lon2[i], 1E-12);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(arc.get_r().get_a(), reverse_azimuth[i], 1E-12);
+    }
+    vincenty_direct(0.7, -0.2, n, azimuth, range, lat2, lon2, reverse_azimuth);
+    for (int i = 0; i < n; ++i) {
+      Arc arc(Position(0.7, -0.2), Vector(azimuth[i], range[i]));
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(arc.get_p2().get_lat(), lat2[i], 1E-12);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(arc.get_p2().get_lon(), lon2[i], 1E-12);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(arc.get_r().get_a(), reverse_azimuth[i], 1E-12);
+    }
+  }
+  void testDistanceMatrix() {
+    // Not a multiple of the tile or lane size
+    const int n = 150;
+    const int m = 70;
+    std::vector<double> lat1(n), lon1(n), lat2(m), lon2(m);
+    for (int i = 0; i < n; ++i) {
+      lat1[i] = -1.2 + 0.016 * i;
+      lon1[i] = angle_pipi(0.05 * i);
+    }
+    for (int i = 0; i < m; ++i) {
+      lat2[i] = 1.1 - 0.03 * i;
+      lon2[i] = angle_pipi(1 - 0.04 * i);
+    }
+    std::vector<double> distance(n * m), azimuth(n * m);
+    distance_matrix(n, &lat1[0], &lon1[0], m, &lat2[0], &lon2[0], &distance[0], &azimuth[0]);
+    for (int i = 0; i < n; i += 7) {
+      for (int j = 0; j < m; j += 3) {
+        Arc arc(Position(lat1[i], lon1[i]), Position(lat2[j], lon2[j]));
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(arc.get_v().get_r(), distance[i * m + j], 1E-6);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(arc.get_v().get_a(), azimuth[i * m + j], 1E-12);
+      }
+    }
+    std::vector<double> symmetric(n * n), forward(n * n), reverse(n * n);
+    distance_matrix(n, &lat1[0], &lon1[0], &symmetric[0], &forward[0], &reverse[0]);
+    for (int i = 0; i < n; i += 3) {
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(0, symmetric[i * n + i], 1E-12);
+      for (int j = 0; j < n; j += 5) {
+        if (i == j)
+          continue;
+        Arc arc(Position(lat1[i], lon1[i]), Position(lat1[j], lon1[j]));
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(arc.get_v().get_r(), symmetric[i * n + j], 1E-6);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(arc.get_v().get_a(), forward[i * n + j], 1E-9);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(arc.get_r().get_a(), reverse[i * n + j], 1E-9);
+      }
+    }
+  }
+  void testRhumbIntersection() {
+    const int n = 20;
+    double lat1[n], lon1[n], lat2[n], lon2[n], lat3[n], lon3[n], lat4[n], lon4[n];
+    double lat[n], lon[n];
+    for (int i = 0; i < n; ++i) {
+      lat1[i] = 0.7;
+      lon1[i] = angle_pipi(pi - 0.01 * i);
+      lat2[i] = 0.72;
+      lon2[i] = angle_pipi(lon1[i] + 0.03);
+      lat3[i] = 0.7305 - 0.002 * i;
+      lon3[i] = lon1[i];
+      lat4[i] = 0.69;
+      lon4[i] = angle_pipi(lon1[i] + 0.04);
+    }
+    rhumb_intersection(n, lat1, lon1, lat2, lon2, lat3, lon3, lat4, lon4, lat, lon);
+    int crossings = 0;
+    for (int i = 0; i < n; ++i) {
+      Line l1(Position(lat1[i], lon1[i]), Position(lat2[i], lon2[i]));
+      Line l2(Position(lat3[i], lon3[i]), Position(lat4[i], lon4[i]));
+      if (std::isnan(lat[i])) {
+        CPPUNIT_ASSERT(std::isnan(lon[i]));
+        CPPUNIT_ASSERT(not l1.intersects(l2));
+        continue;
+      }
+      ++crossings;
+      Position x = l1.intersection(l2);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(x.get_lat(), lat[i], 1E-12);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(x.get_lon(), lon[i], 1E-12);
+    }
+    CPPUNIT_ASSERT(crossings > 0 and crossings < n);
+  }
+  void testGeodesicLine() {
+    Arc arc(Position(0.8, 0.8), Position(-0.3, 2.0));
+    GeodesicLine line(arc);
+    double lat, lon, azimuth;
+    line.position(line.get_length(), &lat, &lon, &azimuth);
+    // Within the Vincenty tolerance
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(-0.3, lat, 1E-7);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(2.0, lon, 1E-7);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(angle_2pi(pi - arc.get_r().get_a()), azimuth, 1E-7);
+    line.fraction(0.3, &lat, &lon);
+    Arc part(arc.get_p1(), Vector(arc.get_v().get_a(), 0.3 * arc.get_v().get_r()));
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(part.get_p2().get_lat(), lat, 1E-12);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(part.get_p2().get_lon(), lon, 1E-12);
+
+    // Batch and lazy waypoints agree with single points
+    const int n = batch_lanes + 3;
+    double lats[n], lons[n], azimuths[n], distances[n];
+    line.waypoints(n, lats, lons);
+    for (int i = 0; i < n; ++i) {
+      distances[i] = line.get_length() * i / (n - 1);
+    }
+    line.positions(n, distances, lats, lons, azimuths);
+    int i = 0;
+    GeodesicLine::Waypoints waypoints = line.waypoints(line.get_length() / (n - 1));
+    CPPUNIT_ASSERT_EQUAL(n, waypoints.size());
+    for (PositionValue p: waypoints) {
+      line.position(distances[i], &lat, &lon, &azimuth);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(lat, lats[i], 1E-12);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(lon, lons[i], 1E-12);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(azimuth, azimuths[i], 1E-12);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(lat, p.lat, 1E-12);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(lon, p.lon, 1E-12);
+      ++i;
+    }
+    CPPUNIT_ASSERT_EQUAL(n, i);
+    CPPUNIT_ASSERT_EQUAL(4, line.waypoints(line.get_length() / 2.5).size());
+    GeodesicLine::Waypoints ends = line.waypoints(0);
+    CPPUNIT_ASSERT_EQUAL(2, ends.size());
+    PositionValue end = *++ends.begin();
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(lats[n - 1], end.lat, 1E-12);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(lons[n - 1], end.lon, 1E-12);
+    CPPUNIT_ASSERT_EQUAL(2, line.waypoints(-1).size());
+    CPPUNIT_ASSERT_EQUAL(std::numeric_limits<int>::max(), line.waypoints(1E-300).size());
+
+    // The ellipsoid is copied, so a temporary one can be passed
+    GeodesicLine temporary(0.6, 0.1, 0.3, 1E5, Ellipsoid(wgs84_ellipsoid.a, wgs84_ellipsoid.b));
+    double lat2, lon2;
+    temporary.position(1E5, &lat, &lon);
+    GeodesicLine(0.6, 0.1, 0.3, 1E5, wgs84_ellipsoid).position(1E5, &lat2, &lon2);
+    CPPUNIT_ASSERT_EQUAL(lat2, lat);
+    CPPUNIT_ASSERT_EQUAL(lon2, lon);
+
+    // Copies keep the vertex angle
+    Arc copy(arc);
+    Arc assigned;
+    assigned = arc;
+    CPPUNIT_ASSERT(copy.max_lat() == arc.max_lat());
+    CPPUNIT_ASSERT(assigned.max_lat() == arc.max_lat());
+  }
+public:
+  CPPUNIT_TEST_SUITE(BatchTest);
+  CPPUNIT_TEST(testVincentyInverse);
+  CPPUNIT_TEST(testVincentyDirect);
+  CPPUNIT_TEST(testDistanceMatrix);
+  CPPUNIT_TEST(testRhumbIntersection);
+  CPPUNIT_TEST(testGeodesicLine);
+  CPPUNIT_TEST_SUITE_END();
+};
+
+class LineIndexTest : public CppUnit::TestFixture {
+  // Short segments scattered around the antimeridian, some crossing it
+  static std::vector<Line> lines(const int n, const int seed) {
+    std::vector<Line> result;
+    unsigned state = seed;
+    for (int i = 0; i < n; ++i) {
+      double v[4];
+      for (int j = 0; j < 4; ++j) {
+        state = state * 1103515245 + 12345;
+        v[j] = (state >> 8) / double(1 << 24);
+      }
+      double lat = -0.5 + v[0];
+      double lon = angle_pipi(pi - 0.5 + v[1]);
+      Position p1(lat, lon);
+      Position p2(lat + 0.1 * v[2] - 0.05, angle_pipi(lon + 0.1 * v[3] - 0.05));
+      result.push_back(Line(p1, p2));
+    }
+    return result;
+  }
+  void testIntersecting() {
+    std::vector<Line> segments = lines(800, 1);
+    LineIndex index(segments);
+    // Segments added after building are searched as well
+    std::vector<Line> extra = lines(50, 2);
+    for (size_t i = 0; i < extra.size(); ++i) {
+      index.add(extra[i]);
+      segments.push_back(extra[i]);
+    }
+    std::vector<Line> queries = lines(40, 3);
+    std::vector<std::vector<int> > found = index.intersecting(queries);
+    int total = 0;
+    for (size_t q = 0; q < queries.size(); ++q) {
+      std::vector<int> expected;
+      for (size_t i = 0; i < segments.size(); ++i) {
+        if (segments[i].intersects(queries[q]))
+          expected.push_back(i);
+      }
+      CPPUNIT_ASSERT(expected == found[q]);
+      CPPUNIT_ASSERT(expected == index.intersecting(queries[q]));
+      total += expected.size();
+    }
+    CPPUNIT_ASSERT(total > 0);
+  }
+  void testWithin() {
+    std::vector<Line> segments = lines(600, 4);
+    LineIndex index(segments);
+    std::vector<LatLonBox> boxes;
+    boxes.push_back(LatLonBox(Position(-0.2, pi - 0.3), Position(0.3, -pi + 0.2)));
+    boxes.push_back(LatLonBox(Position(-0.5, pi - 0.1), Position(0.0, pi - 0.01)));
+    boxes.push_back(LatLonBox(Position(0.1, -pi + 0.05), Position(0.4, -pi + 0.4)));
+    std::vector<std::vector<int> > found = index.within(boxes);
+    for (size_t b = 0; b < boxes.size(); ++b) {
+      std::vector<int> expected;
+      for (size_t i = 0; i < segments.size(); ++i) {
+        // Segments are short, so containing both ends means containing all
+        if (boxes[b].contains(segments[i].get_p1()) and boxes[b].contains(segments[i].get_p2()))
+          expected.push_back(i);
+      }
+      CPPUNIT_ASSERT(not expected.empty());
+      CPPUNIT_ASSERT(expected == found[b]);
+    }
+    CPPUNIT_ASSERT(index.within(LatLonBox(Position(1.0, 0), Position(1.1, 0.1))).empty());
+  }
+  // crossings against all pairs
+  static void check_crossings(const std::vector<Line>& lines1, const std::vector<Line>& lines2) {
+    std::vector<Crossing> found = crossings(lines1, lines2);
+    size_t k = 0;
+    for (size_t i = 0; i < lines1.size(); ++i) {
+      for (size_t j = 0; j < lines2.size(); ++j) {
+        if (not lines1[i].intersects(lines2[j]))
+          continue;
+        CPPUNIT_ASSERT(k < found.size());
+        CPPUNIT_ASSERT_EQUAL(int(i), found[k].first);
+        CPPUNIT_ASSERT_EQUAL(int(j), found[k].second);
+        Position x = lines1[i].intersection(lines2[j]);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(0, (found[k].position - x).get_r(), 1E-6);
+        ++k;
+      }
+    }
+    CPPUNIT_ASSERT(k > 0);
+    CPPUNIT_ASSERT_EQUAL(k, found.size());
+  }
+  void testCrossings() {
+    check_crossings(lines(500, 5), lines(300, 6));
+
+    // One wide line across the antimeridian among the short ones
+    std::vector<Line> lines2 = lines(300, 6);
+    lines2.insert(lines2.begin() + 100, Line(Position(0.02, pi - 0.6), Position(-0.03, 0.6 - pi)));
+    check_crossings(lines(500, 5), lines2);
+    check_crossings(lines2, lines(500, 5));
+  }
+public:
+  CPPUNIT_TEST_SUITE(LineIndexTest);
+  CPPUNIT_TEST(testIntersecting);
+  CPPUNIT_TEST(testWithin);
+  CPPUNIT_TEST(testCrossings);
+  CPPUNIT_TEST_SUITE_END();
+};
+
+class PositionIndexTest : public CppUnit::TestFixture {
+  // Positions clustered around the poles and the antimeridian, and spread
+  // over the rest of the globe
+  static void positions(const int n, std::vector<double>* lat, std::vector<double>* lon) {
+    lat->resize(n);
+    lon->resize(n);
+    for (int i = 0; i < n; ++i) {
+      const double u = fmod(0.6180339887 * i, 1.0);
+      const double v = fmod(0.7548776662 * i, 1.0);
+      switch (i % 3) {
+        case 0:
+          (*lat)[i] = (i % 2 ? 1 : -1) * (half_pi - 0.05 * u);
+          (*lon)[i] = two_pi * v - pi;
+          break;
+        case 1:
+          (*lat)[i] = 0.4 * u - 0.2;
+          (*lon)[i] = angle_pipi(pi + 0.05 * (v - 0.5));
+          break;
+        default:
+          (*lat)[i] = asin(2 * u - 1);
+          (*lon)[i] = two_pi * v - pi;
+      }
+    }
+  }
+  static std::vector<Neighbour> brute_force(const std::vector<double>& lat,
+      const std::vector<double>& lon, const Position& p, const PositionDistance distance) {
+    std::vector<Neighbour> result;
+    for (size_t i = 0; i < lat.size(); ++i) {
+      Neighbour n = {int(i), 0};
+      Position q(lat[i], lon[i]);
+      if (distance == pd_geodesic)
+        n.distance = Arc(p, q).get_v().get_r();
+      else
+        n.distance = (q - p).get_r();
+      result.push_back(n);
+    }
+    std::sort(result.begin(), result.end(), [](const Neighbour& n1, const Neighbour& n2) {
+      return n1.distance < n2.distance or (n1.distance == n2.distance and n1.index < n2.index);
+    });
+    return result;
+  }
+  void testQueries() {
+    std::vector<double> lat, lon;
+    positions(3000, &lat, &lon);
+    PositionIndex index(3000, &lat[0], &lon[0]);
+    CPPUNIT_ASSERT_EQUAL(3000, index.size());
+    CPPUNIT_ASSERT(index[7] == Position(lat[7], lon[7]));
+    const Position queries[] = {
+        Position(half_pi, 0), Position(-1.55, 2.0), Position(0.01, pi),
+        Position(-0.05, -3.13), Position(0.7, 0.7), Position(lat[5], lon[5])};
+    const PositionDistance distances[] = {pd_geodesic, pd_rhumb};
+    for (int i = 0; i < 6; ++i) {
+      for (int j = 0; j < 2; ++j) {
+        std::vector<Neighbour> expected = brute_force(lat, lon, queries[i], distances[j]);
+        std::vector<Neighbour> found = index.nearest(queries[i], 10, distances[j]);
+        CPPUNIT_ASSERT_EQUAL(size_t(10), found.size());
+        for (int k = 0; k < 10; ++k) {
+          CPPUNIT_ASSERT_EQUAL(expected[k].index, found[k].index);
+          CPPUNIT_ASSERT_DOUBLES_EQUAL(expected[k].distance, found[k].distance, 1E-6);
+        }
+        const double radius = expected[25].distance;
+        found = index.within(queries[i], radius, distances[j]);
+        CPPUNIT_ASSERT_EQUAL(size_t(26), found.size());
+        CPPUNIT_ASSERT_EQUAL(expected[25].index, found.back().index);
+      }
+    }
+    CPPUNIT_ASSERT_EQUAL(0.0, index.nearest(queries[5], 1)[0].distance);
+    CPPUNIT_ASSERT_EQUAL(5, index.nearest(queries[5], 1)[0].index);
+  }
+  void testBatch() {
+    std::vector<double> lat, lon;
+    positions(500, &lat, &lon);
+    std::vector<Position> points;
+    for (int i = 0; i < 500; ++i) {
+      points.push_back(Position(lat[i], lon[i]));
+    }
+    PositionIndex index(points);
+    std::vector<Position> queries(points.begin(), points.begin() + 50);
+    std::vector<std::vector<Neighbour> > nearest = index.nearest(queries, 3, pd_rhumb);
+    std::vector<std::vector<Neighbour> > within = index.within(queries, 2E5);
+    for (int i = 0; i < 50; ++i) {
+      std::vector<Neighbour> n = index.nearest(queries[i], 3, pd_rhumb);
+      std::vector<Neighbour> w = index.within(queries[i], 2E5);
+      CPPUNIT_ASSERT_EQUAL(n.size(), nearest[i].size());
+      CPPUNIT_ASSERT_EQUAL(w.size(), within[i].size());
+      CPPUNIT_ASSERT_EQUAL(i, n[0].index);
+      for (size_t k = 0; k < w.size(); ++k) {
+        CPPUNIT_ASSERT_EQUAL(w[k].index, within[i][k].index);
+      }
+    }
+    CPPUNIT_ASSERT_EQUAL(size_t(500), index.nearest(queries[0], 600).size());
+    CPPUNIT_ASSERT(PositionIndex().nearest(queries[0], 3).empty());
+    CPPUNIT_ASSERT_THROW(index[500], IndexError);
+  }
+public:
+  CPPUNIT_TEST_SUITE(PositionIndexTest);
+  CPPUNIT_TEST(testQueries);
+  CPPUNIT_TEST(testBatch);
+  CPPUNIT_TEST_SUITE_END();
+};
+
+class PolygonTest : public CppUnit::TestFixture {
+  // Star shaped polygon of n vertices counterclockwise around a center
+  static std::vector<Position> star(const int n, const double lat, const double lon) {
+    std::vector<Position> result;
+    for (int i = 0; i < n; ++i) {
+      const double t = two_pi * i / n;
+      const double r = 0.1 + 0.04 * sin(7 * t) + 0.01 * cos(31 * t);
+      result.push_back(Position(lat + r * sin(t), angle_pipi(lon + 1.3 * r * cos(t))));
+    }
+    return result;
+  }
+  // Edges crossing the meridian north of a position, counted one by one in
+  // (longitude, isometric latitude) relative to a longitude near the polygon
+  static bool brute_force(const std::vector<Position>& vertices, const Position& p,
+      const double lon0) {
+    const Ellipsoid& e = get_earth_model()->get_ellipsoid();
+    const double x = angle_diff(p.value().lon, lon0);
+    const double y = e.isometric_latitude(p.value().lat);
+    bool inside = false;
+    for (size_t i = 0; i < vertices.size(); ++i) {
+      PositionValue p1 = vertices[i].value();
+      PositionValue p2 = vertices[(i + 1) % vertices.size()].value();
+      const double x1 = angle_diff(p1.lon, lon0);
+      const double x2 = angle_diff(p2.lon, lon0);
+      const double y1 = e.isometric_latitude(p1.lat);
+      const double y2 = e.isometric_latitude(p2.lat);
+      if ((x1 <= x) != (x2 <= x) and y1 + (x - x1) * (y2 - y1) / (x2 - x1) > y) {
+        inside = not inside;
+      }
+    }
+    return inside;
+  }
+  void testContains() {
+    // The same star at the prime meridian and across the antimeridian
+    const double centers[] = {0.0, 3.1};
+    for (int c = 0; c < 2; ++c) {
+      std::vector<Position> vertices = star(400, 0.6, centers[c]);
+      Polygon polygon(vertices);
+      CPPUNIT_ASSERT_EQUAL(400, polygon.size());
+      CPPUNIT_ASSERT_EQUAL(c == 1, polygon.get_bounding_box().crosses_antimeridian());
+      int inside = 0;
+      for (int i = 0; i < 2000; ++i) {
+        const double u = fmod(0.6180339887 * i, 1.0);
+        const double v = fmod(0.7548776662 * i, 1.0);
+        Position p(0.6 + 0.3 * (u - 0.5), angle_pipi(centers[c] + 0.4 * (v - 0.5)));
+        const bool expected = brute_force(vertices, p, centers[c]);
+        CPPUNIT_ASSERT_EQUAL(expected, polygon.contains(p));
+        inside += expected;
+      }
+      CPPUNIT_ASSERT(inside > 500 and inside < 1500);
+
+      // Edges are rhumb lines: 10 meters to the left of the middle of an
+      // edge is inside, 10 meters to the right outside
+      for (int i = 0; i < 400; i += 7) {
+        Line edge(vertices[i], vertices[(i + 1) % 400]);
+        Position middle = edge.get_p1() + edge.get_v() * 0.5;
+        const double a = edge.get_v().get_a();
+        CPPUNIT_ASSERT(polygon.contains(middle + Vector(a - half_pi, 10)));
+        CPPUNIT_ASSERT(not polygon.contains(middle + Vector(a + half_pi, 10)));
+      }
+    }
+    std::vector<Line> edges;
+    edges.push_back(Line(Position(0.1, 0.1), Position(0.1, 0.2)));
+    edges.push_back(Line(Position(0.1, 0.2), Position(0.2, 0.2)));
+    edges.push_back(Line(Position(0.2, 0.2), Position(0.2, 0.1)));
+    Polygon triangle(edges);
+    CPPUNIT_ASSERT(triangle.contains(Position(0.15, 0.18)));
+    CPPUNIT_ASSERT(not triangle.contains(Position(0.15, 0.12)));
+    CPPUNIT_ASSERT(not Polygon().contains(Position(0.15, 0.18)));
+    CPPUNIT_ASSERT_THROW(triangle[3], IndexError);
+  }
+  void testPole() {
+    // A ring running east contains the north cap, running west the south
+    std::vector<Position> ring;
+    for (int i = 0; i < 12; ++i) {
+      ring.push_back(Position(1.2 + 0.05 * (i % 2), angle_pipi(two_pi * i / 12)));
+    }
+    Polygon north(ring);
+    CPPUNIT_ASSERT(north.contains(Position(half_pi, 0)));
+    CPPUNIT_ASSERT(north.contains(Position(1.3, 2.0)));
+    CPPUNIT_ASSERT(not north.contains(Position(1.1, -2.0)));
+    CPPUNIT_ASSERT(not north.contains(Position(-0.5, 0.5)));
+    CPPUNIT_ASSERT_EQUAL(half_pi, north.get_bounding_box().max_lat);
+    std::reverse(ring.begin(), ring.end());
+    Polygon south(ring);
+    CPPUNIT_ASSERT(not south.contains(Position(1.3, 2.0)));
+    CPPUNIT_ASSERT(south.contains(Position(1.1, -2.0)));
+    CPPUNIT_ASSERT(south.contains(Position(-half_pi, 0)));
+  }
+  void testBatch() {
+    // A grid of small geofences and positions around them
+    std::vector<Polygon> polygons;
+    for (int i = 0; i < 100; ++i) {
+      polygons.push_back(Polygon(star(40 + i, -0.5 + 0.1 * (i / 10), angle_pipi(2.5 + 0.15 * (i % 10)))));
+    }
+    std::vector<Position> positions;
+    std::vector<double> lat, lon;
+    for (int i = 0; i < 3000; ++i) {
+      const double u = fmod(0.6180339887 * i, 1.0);
+      const double v = fmod(0.7548776662 * i, 1.0);
+      positions.push_back(Position(-0.6 + 1.2 * u, angle_pipi(2.4 + 1.6 * v)));
+      lat.push_back(positions.back().value().lat);
+      lon.push_back(positions.back().value().lon);
+    }
+    std::vector<char> inside(3000 * 100);
+    containing(polygons, 3000, &lat[0], &lon[0], &inside[0]);
+    std::vector<std::vector<int> > found = containing(polygons, positions);
+    int hits = 0;
+    for (int i = 0; i < 3000; ++i) {
+      std::vector<int> expected;
+      for (int j = 0; j < 100; ++j) {
+        CPPUNIT_ASSERT_EQUAL(polygons[j].contains(positions[i]), bool(inside[i * 100 + j]));
+        if (inside[i * 100 + j]) {
+          expected.push_back(j);
+        }
+      }
+      CPPUNIT_ASSERT(expected == found[i]);
+      hits += static_cast<int>(expected.size());
+    }
+    CPPUNIT_ASSERT(hits > 300);
+  }
+public:
+  CPPUNIT_TEST_SUITE(PolygonTest);
+  CPPUNIT_TEST(testContains);
+  CPPUNIT_TEST(testPole);
+  CPPUNIT_TEST(testBatch);
+  CPPUNIT_TEST_SUITE_END();
+};
+
+class TrackTest : public CppUnit::TestFixture {
+  void testDistance() {
+    // A zigzag track with one fix per minute
+    const int n = 1000;
+    std::vector<double> lat(n), lon(n), time(n);
+    for (int i = 0; i < n; ++i) {
+      lat[i] = 0.8 + (i % 2) * 0.001;
+      lon[i] = 0.1 + 0.0005 * i;
+      time[i] = 60.0 * i;
+    }
+    Track track;
+    track.append(Position(lat[0], lon[0]), time[0]);
+    track.append(n - 1, &lat[1], &lon[1], &time[1]);
+    CPPUNIT_ASSERT_EQUAL(n, track.size());
+    double length = 0;
+    for (int i = 1; i < n; ++i) {
+      Vector v = track[i] - track[i - 1];
+      length += v.get_r();
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(length, track.distance(i), 1E-6);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(v.get_a(), track.leg(i - 1).get_a(), 1E-12);
+    }
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(length, track.get_length(), 1E-6);
+
+    // Halfway leg 500 by distance and by time
+    double d = 0.5 * (track.distance(500) + track.distance(501));
+    Position p = track.at_distance(d);
+    Position expected = track[500] + track.leg(500) * 0.5;
+    CPPUNIT_ASSERT(p == expected);
+    CPPUNIT_ASSERT(track.at_time(60.0 * 500.5) == expected);
+    CPPUNIT_ASSERT(track.at_distance(track.distance(7)) == track[7]);
+    CPPUNIT_ASSERT(track.at_distance(-1) == track[0]);
+    CPPUNIT_ASSERT(track.at_time(1E9) == track[n - 1]);
+    CPPUNIT_ASSERT_THROW(track.leg(n - 1), IndexError);
+    CPPUNIT_ASSERT_THROW(Track().at_distance(0), IndexError);
+  }
+  void testSlice() {
+    Track track(tl_geodesic);
+    for (int i = 0; i < 20; ++i) {
+      track.append(Position(0.1 * i - 1, 0.2 * i));
+    }
+    Arc arc(track[3], track[4]);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(arc.get_v().get_r(), track.leg(3).get_r(), 1E-6);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(arc.get_v().get_a(), track.leg(3).get_a(), 1E-12);
+    Position p = track.at_distance(track.distance(3) + 1000);
+    Arc part(track[3], Vector(arc.get_v().get_a(), 1000));
+    CPPUNIT_ASSERT(p == part.get_p2());
+
+    Track slice = track.slice(3, -5);
+    CPPUNIT_ASSERT_EQUAL(12, slice.size());
+    CPPUNIT_ASSERT(slice[0] == track[3]);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(track.distance(14) - track.distance(3), slice.get_length(), 1E-6);
+    CPPUNIT_ASSERT(slice.at_distance(2000) == track.at_distance(track.distance(3) + 2000));
+    CPPUNIT_ASSERT_EQUAL(0, track.slice(5, 2).size());
+
+    // Appends only solve the new legs and keep the slice independent
+    slice.append(Position(0.5, 3.0));
+    CPPUNIT_ASSERT_EQUAL(13, slice.size());
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(slice.distance(11) + Arc(slice[11], slice[12]).get_v().get_r(),
+        slice.get_length(), 1E-6);
+    CPPUNIT_ASSERT_EQUAL(20, track.size());
+  }
+  void testRoute() {
+    Context c = get_context();
+    c.vincenty_tolerance = 1E-13;
+    ScopedContext s(c);
+    // A long geodesic leg bulging north of its ends, between short legs
+    Track route(tl_geodesic);
+    route.append(Position(0.6, -0.1));
+    route.append(Position(0.7, 0.0));
+    route.append(Position(0.7, 1.5));
+    route.append(Position(0.5, 1.6));
+    route.append(Position(0.73, 0.8));
+    Position vertex = route.at_distance(0.5 * (route.distance(1) + route.distance(2)));
+    CPPUNIT_ASSERT(vertex.get_lat() > 0.75);
+
+    // The foot is perpendicular to the leg and no point of any leg is
+    // nearer than it
+    std::vector<Position> positions;
+    for (int i = 0; i < 40; ++i) {
+      positions.push_back(Position(0.55 + 0.006 * i, -0.15 + 0.045 * i));
+    }
+    positions.push_back(Position(vertex.get_lat() + 0.001, vertex.get_lon()));
+    std::vector<RouteOffset> offsets = route.offsets(positions);
+    for (size_t i = 0; i < positions.size(); ++i) {
+      const RouteOffset& o = offsets[i];
+      Position foot = route.at_distance(o.along_track);
+      Arc arc(foot, positions[i]);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(fabs(o.cross_track), arc.get_v().get_r(), 1E-3);
+      if (o.along_track > route.distance(o.leg) and o.along_track < route.distance(o.leg + 1)) {
+        Position behind = route.at_distance(o.along_track - 1);
+        const double turn = angle_pipi(arc.get_v().get_a() - (foot - behind).get_a());
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(o.cross_track > 0 ? half_pi : -half_pi, turn, 1E-5);
+      }
+      for (double d = 0; d <= route.get_length(); d += 2000) {
+        Arc sample(route.at_distance(d), positions[i]);
+        CPPUNIT_ASSERT(sample.get_v().get_r() > fabs(o.cross_track) - 1E-3);
+      }
+    }
+    // Left of the leg is negative, and the position above the vertex is
+    // found on the leg despite lying far north of both its ends
+    CPPUNIT_ASSERT_EQUAL(1, offsets.back().leg);
+    CPPUNIT_ASSERT(offsets.back().cross_track < 0);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(0.5 * (route.distance(1) + route.distance(2)),
+        offsets.back().along_track, 1E-3);
+
+    // The array version agrees, and positions beyond the ends are offset
+    // from them
+    std::vector<double> lat(positions.size()), lon(positions.size());
+    for (size_t i = 0; i < positions.size(); ++i) {
+      lat[i] = positions[i].value().lat;
+      lon[i] = positions[i].value().lon;
+    }
+    std::vector<int> leg(lat.size());
+    std::vector<double> cross(lat.size()), along(lat.size());
+    route.offsets(static_cast<int>(lat.size()), &lat[0], &lon[0], &leg[0], &cross[0], &along[0]);
+    for (size_t i = 0; i < lat.size(); ++i) {
+      CPPUNIT_ASSERT_EQUAL(offsets[i].leg, leg[i]);
+      CPPUNIT_ASSERT_EQUAL(offsets[i].cross_track, cross[i]);
+      CPPUNIT_ASSERT_EQUAL(offsets[i].along_track, along[i]);
+    }
+    RouteOffset start = route.offset(Position(0.59, -0.12));
+    CPPUNIT_ASSERT_EQUAL(0, start.leg);
+    CPPUNIT_ASSERT_EQUAL(0.0, start.along_track);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(Arc(route[0], Position(0.59, -0.12)).get_v().get_r(),
+        fabs(start.cross_track), 1E-6);
+
+    // Rhumb line legs across the antimeridian
+    Track rhumb;
+    rhumb.append(Position(-0.3, 3.0));
+    rhumb.append(Position(-0.2, -3.0));
+    Position on = rhumb.at_distance(0.3 * rhumb.get_length());
+    RouteOffset o = rhumb.offset(on);
+    CPPUNIT_ASSERT_EQUAL(0, o.leg);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(0.0, o.cross_track, 1E-3);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(0.3 * rhumb.get_length(), o.along_track, 1E-3);
+    o = rhumb.offset(on + Vector(rhumb.leg(0).get_a() + half_pi, 5000));
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(5000, o.cross_track, 1);
+    CPPUNIT_ASSERT_THROW(Track().offset(on), IndexError);
+  }
+public:
+  CPPUNIT_TEST_SUITE(TrackTest);
+  CPPUNIT_TEST(testDistance);
+  CPPUNIT_TEST(testSlice);
+  CPPUNIT_TEST(testRoute);
+  CPPUNIT_TEST_SUITE_END();
+};
+
+class FileTest : public CppUnit::TestFixture {
+  void testTrack() {
+    const char* path = "test_geofun.tmp";
+    const int n = 250;
+    std::vector<double> lat(n), lon(n), time(n);
+    for (int i = 0; i < n; ++i) {
+      lat[i] = 0.8 + 0.001 * i;
+      lon[i] = -0.3 + 0.0007 * i;
+      time[i] = 10.0 * i;
+    }
+    {
+      // Chunks of 100, 100 and 50 fixes
+      FileWriter writer(path, fk_track, fe_float64, 100);
+      writer.write(Position(lat[0], lon[0]), time[0]);
+      writer.write(n - 1, &lat[1], &lon[1], &time[1]);
+    }
+    FileReader reader(path);
+    CPPUNIT_ASSERT_EQUAL(fk_track, reader.get_kind());
+    CPPUNIT_ASSERT_EQUAL(3, reader.chunks());
+    CPPUNIT_ASSERT_EQUAL(int64_t(n), reader.size());
+    CPPUNIT_ASSERT_EQUAL(50, reader.chunk(2).count);
+    std::vector<double> values(n);
+    reader.read(2, &values[0]);
+    CPPUNIT_ASSERT(values == time);
+    // Header, then a count and three columns of 100 values per chunk
+    CPPUNIT_ASSERT_EQUAL(size_t(40), reader.column_offset(0, 0));
+    CPPUNIT_ASSERT_EQUAL(size_t(40 + 3 * 800 + 8 + 800), reader.column_offset(1, 1));
+    CPPUNIT_ASSERT_THROW(reader.column_offset(0, 3), IndexError);
+    CPPUNIT_ASSERT_THROW(reader.column_offset(3, 0), IndexError);
+
+    // Batch kernels run on the mapped columns
+    const FileChunk& chunk = reader.chunk(1);
+    std::vector<double> distance(chunk.count - 1), azimuth(chunk.count - 1);
+    vincenty_inverse(chunk.count - 1, chunk.angle(0), chunk.angle(1),
+        chunk.angle(0) + 1, chunk.angle(1) + 1, &distance[0], &azimuth[0], 0);
+    Arc arc(Position(lat[100], lon[100]), Position(lat[101], lon[101]));
+    CPPUNIT_ASSERT_EQUAL(arc.get_v().get_r(), distance[0]);
+    CPPUNIT_ASSERT_EQUAL(time[100], chunk.time()[0]);
+    std::remove(path);
+  }
+  void testQuantized() {
+    const char* path = "test_geofun.tmp";
+    std::vector<Line> lines;
+    for (int i = 0; i < 7; ++i) {
+      lines.push_back(Line(Position(0.2 * i - 0.7, 0.5 * i - 3), Position(-0.1 * i, pi)));
+    }
+    FileWriter writer(path, fk_lines, fe_int32);
+    for (size_t i = 0; i < lines.size(); ++i) {
+      writer.write(lines[i]);
+    }
+    writer.close();
+    FileReader reader(path);
+    CPPUNIT_ASSERT_EQUAL(fe_int32, reader.get_encoding());
+    CPPUNIT_ASSERT_EQUAL(int64_t(7), reader.size());
+    std::vector<double> lat1(7), lon2(7);
+    reader.read(0, &lat1[0]);
+    reader.read(3, &lon2[0]);
+    for (int i = 0; i < 7; ++i) {
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(lines[i].get_p1().get_lat(), lat1[i], 0.5 * angle_quantum);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(-pi, lon2[i], 0.5 * angle_quantum);
+    }
+    CPPUNIT_ASSERT_THROW(reader.read(4, &lat1[0]), IndexError);
+    CPPUNIT_ASSERT_THROW(writer.write(lines[0]), FileError);
+    std::remove(path);
+    CPPUNIT_ASSERT_THROW(FileReader reader(path), FileError);
+    FILE* f = fopen(path, "wb");
+    fputs("GEOFUN but not really a geofun file", f);
+    fclose(f);
+    CPPUNIT_ASSERT_THROW(FileReader reader(path), FileError);
+    std::remove(path);
+
+    // A failed flush drops the chunk, and close still closes the file
+    f = fopen("/dev/full", "wb");
+    if (f) {
+      fclose(f);
+      std::vector<double> column(1024, 0.5);
+      FileWriter full("/dev/full", fk_lines, fe_float64, 1024);
+      CPPUNIT_ASSERT_THROW(full.write(1024, &column[0], &column[0], &column[0], &column[0]),
+          FileError);
+      CPPUNIT_ASSERT_THROW(full.close(), FileError);
+      full.close();
+      CPPUNIT_ASSERT_THROW(full.write(lines[0]), FileError);
+    }
+  }
+public:
+  CPPUNIT_TEST_SUITE(FileTest);
+  CPPUNIT_TEST(testTrack);
+  CPPUNIT_TEST(testQuantized);
+  CPPUNIT_TEST_SUITE_END();
+};
+
+class CompactTest : public CppUnit::TestFixture {
+  void testQuantized() {
+    const int n = 1000;
+    std::vector<double> lat(n), lon(n);
+    for (int i = 0; i < n; ++i) {
+      lat[i] = 1.5 * sin(0.37 * i);
+      lon[i] = pi * cos(0.11 * i);
+    }
+    QuantizedPositions positions;
+    positions.append(n, &lat[0], &lon[0]);
+    positions.append(Position(0.5, pi));
+    CPPUNIT_ASSERT_EQUAL(n + 1, positions.size());
+    QuantizedPositions empty;
+    empty.append(0, lat.data(), lon.data());
+    QuantizedTrack empty_track;
+    empty_track.append(0, 0, 0);
+    CPPUNIT_ASSERT_EQUAL(0, empty.size() + empty_track.size());
+    std::vector<double> decoded_lat(n), decoded_lon(n);
+    positions.decode(0, n, &decoded_lat[0], &decoded_lon[0]);
+    for (int i = 0; i < n; ++i) {
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(lat[i], decoded_lat[i], 0.5 * angle_quantum);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(0, angle_diff(lon[i], decoded_lon[i]), 0.5 * angle_quantum);
+    }
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(-pi, positions[n].get_lon(), 1E-15);
+    CPPUNIT_ASSERT_THROW(positions[n + 1], IndexError);
+    CPPUNIT_ASSERT_THROW(positions.decode(n, 2, &lat[0], &lon[0]), IndexError);
+
+    // Legs solved on the quantized form are within a few centimeters of
+    // those on the exact positions
+    std::vector<double> exact(n - 1), distance(n), azimuth(n);
+    vincenty_inverse(n - 1, &lat[0], &lon[0], &lat[1], &lon[1], &exact[0], 0, 0);
+    positions.legs(&distance[0], &azimuth[0]);
+    for (int i = 0; i < n - 1; ++i) {
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(exact[i], distance[i], 3E-2);
+    }
+  }
+  void testTrack() {
+    FloatTrack track;
+    for (int i = 0; i < 50; ++i) {
+      track.append(Position(0.7 + 0.001 * i, -2.0 + 0.002 * i), 30.0 * i);
+    }
+    track.append(Position(0.8, -1.9));
+    CPPUNIT_ASSERT_EQUAL(51, track.size());
+    CPPUNIT_ASSERT_EQUAL(30.0 * 7, track.get_time(7));
+    CPPUNIT_ASSERT(std::isnan(track.get_time(50)));
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(0.7 + 0.001 * 7, track[7].get_lat(), 1.2E-7);
+
+    Track exact;
+    for (int i = 0; i < 50; ++i) {
+      exact.append(Position(0.7 + 0.001 * i, -2.0 + 0.002 * i), 30.0 * i);
+    }
+    Track decoded = track.to_track();
+    CPPUNIT_ASSERT_EQUAL(51, decoded.size());
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(exact.distance(49), decoded.distance(49), 2);
+    Vector error = decoded.at_time(30.0 * 10.5) - exact.at_time(30.0 * 10.5);
+    CPPUNIT_ASSERT(error.get_r() < 1);
+  }
+public:
+  CPPUNIT_TEST_SUITE(CompactTest);
+  CPPUNIT_TEST(testQuantized);
+  CPPUNIT_TEST(testTrack);
+  CPPUNIT_TEST_SUITE_END();
+};
+
+class NVectorTest : public CppUnit::TestFixture {
+  void testConversion() {
+    const double lats[] = {0, 0.3, -0.9, 1.4, -half_pi, half_pi};
+    const double lons[] = {0, 2.0, -3.1, pi, 0.5, -1.0};
+    for (int i = 0; i < 6; ++i) {
+      PositionValue p = {lats[i], lons[i]};
+      Cartesian n = nvector(p);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(1, norm(n), 1E-15);
+      PositionValue q = nvector_position(n);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(p.lat, q.lat, 1E-15);
+      if (fabs(p.lat) < half_pi) {
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(0, angle_diff(p.lon, q.lon), 1E-15);
+      }
+      const double heights[] = {0, -100, 8848, 4E5};
+      for (int j = 0; j < 4; ++j) {
+        Cartesian c = ecef(p, wgs84_ellipsoid, heights[j]);
+        double h;
+        PositionValue r = ecef_position(c, wgs84_ellipsoid, &h);
+        Cartesian d = ecef(r, wgs84_ellipsoid, h) - c;
+        CPPUNIT_ASSERT(norm(d) < 1E-6);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(heights[j], h, 1E-6);
+      }
+    }
+    PositionValue equator = {0, 0}, pole = {half_pi, 0};
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(a, ecef(equator, wgs84_ellipsoid).x, 1E-9);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(b, ecef(pole, wgs84_ellipsoid).z, 1E-9);
+
+    // The batch versions yield the same
+    double x[6], y[6], z[6], lat[6], lon[6], height[6];
+    ecef(6, lats, lons, x, y, z, grs80_ellipsoid);
+    ecef_position(6, x, y, z, lat, lon, height, grs80_ellipsoid);
+    for (int i = 0; i < 6; ++i) {
+      PositionValue p = {lats[i], lons[i]};
+      Cartesian c = ecef(p, grs80_ellipsoid);
+      CPPUNIT_ASSERT_EQUAL(c.x, x[i]);
+      CPPUNIT_ASSERT_EQUAL(c.z, z[i]);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(lats[i], lat[i], 1E-14);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(0, height[i], 1E-6);
+    }
+  }
+  void testGreatCircle() {
+    PositionValue p1 = {0.8, -0.2}, p2 = {0.3, 1.1};
+    Cartesian n1 = nvector(p1), n2 = nvector(p2);
+    // Haversine on the same sphere
+    double h = sqr(sin((p2.lat - p1.lat) / 2))
+        + cos(p1.lat) * cos(p2.lat) * sqr(sin((p2.lon - p1.lon) / 2));
+    double expected = 2 * r * asin(sqrt(h));
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(expected, great_circle_distance(n1, n2, r), 1E-6);
+    {
+      ScopedContext context(Context("radians", "spherical"));
+      Position q1(p1), q2(p2);
+      Arc arc(q1, q2);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(arc.get_v().get_r(), great_circle_distance(n1, n2), 1E-3);
+    }
+
+    Cartesian m = midpoint(n1, n2);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(0.5 * expected, great_circle_distance(n1, m, r), 1E-6);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(0.5 * expected, great_circle_distance(m, n2, r), 1E-6);
+    Cartesian q = interpolate(n1, n2, 0.25);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(1, norm(q), 1E-15);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(0.25 * expected, great_circle_distance(n1, q, r), 1E-6);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(0.75 * expected, great_circle_distance(q, n2, r), 1E-6);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(0, great_circle_distance(n1, interpolate(n1, n1, 0.5)), 1E-9);
+
+    // Nearly antipodal points keep their accuracy
+    PositionValue antipode = {-p1.lat, p1.lon + pi - 1E-9};
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(pi - 1E-9 * cos(p1.lat),
+        angle_between(n1, nvector(antipode)), 1E-15);
+
+    double x[2] = {n1.x, n2.x}, y[2] = {n1.y, n2.y}, z[2] = {n1.z, n2.z}, d[2];
+    great_circle_distance(1, x, y, z, x + 1, y + 1, z + 1, d, r);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(expected, d[0], 1E-6);
+  }
+public:
+  CPPUNIT_TEST_SUITE(NVectorTest);
+  CPPUNIT_TEST(testConversion);
+  CPPUNIT_TEST(testGreatCircle);
+  CPPUNIT_TEST_SUITE_END();
+};
+
+class LocalProjectionTest : public CppUnit::TestFixture {
+  void testErrorBudget() {
+    // Reference geodesics need a tighter tolerance than the default
+    Context context = get_context();
+    context.vincenty_tolerance = 1E-13;
+    ScopedContext scoped(context);
+    const double lats[] = {0, 0.5, -0.9, 1.2};
+    const double ranges[] = {1E3, 1E4, 5E4};
+    for (int i = 0; i < 4; ++i) {
+      // Near the antimeridian, so that the area wraps around it
+      Position origin(lats[i], 3.1);
+      LocalProjection projection(origin);
+      for (int j = 0; j < 3; ++j) {
+        const double d = ranges[j];
+        const double budget = sqr(d / r) * (0.15 + 0.2 * sqr(tan(lats[i])));
+        for (int k = 0; k < 36; ++k) {
+          Vector v(k * pi / 18, d);
+          Position p = Arc(origin, v).get_p2();
+          Coord c = projection.to_coord(p);
+          CPPUNIT_ASSERT_DOUBLES_EQUAL(d, hypot(c.get_x(), c.get_y()), budget * d);
+          CPPUNIT_ASSERT_DOUBLES_EQUAL(0,
+              angle_diff(atan2(c.get_y(), c.get_x()), v.get_a()), budget);
+          Position q = projection.to_position(c);
+          CPPUNIT_ASSERT_DOUBLES_EQUAL(p.get_lat(), q.get_lat(), 1E-13);
+          CPPUNIT_ASSERT_DOUBLES_EQUAL(0, angle_diff(p.get_lon(), q.get_lon()), 1E-13);
+        }
+      }
+    }
+  }
+  void testBatch() {
+    LocalProjection projection(Position(0.9, -0.4));
+    const int n = 20;
+    double lat[n], lon[n], x[n], y[n], lat2[n], lon2[n];
+    for (int i = 0; i < n; ++i) {
+      lat[i] = 0.9 + 0.001 * (i - 10);
+      lon[i] = -0.4 + 0.0013 * (i % 7 - 3);
+    }
+    projection.to_coord(n, lat, lon, x, y);
+    projection.to_position(n, x, y, lat2, lon2);
+    for (int i = 0; i < n; ++i) {
+      PositionValue p = {lat[i], lon[i]};
+      CoordValue c = projection.to_coord(p);
+      CPPUNIT_ASSERT_EQUAL(c.x, x[i]);
+      CPPUNIT_ASSERT_EQUAL(c.y, y[i]);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(lat[i], lat2[i], 1E-15);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(lon[i], lon2[i], 1E-15);
+    }
+    CPPUNIT_ASSERT(projection.get_origin() == Position(0.9, -0.4));
+    CPPUNIT_ASSERT(projection.to_coord(projection.get_origin()) == Coord(0, 0));
+  }
+public:
+  CPPUNIT_TEST_SUITE(LocalProjectionTest);
+  CPPUNIT_TEST(testErrorBudget);
+  CPPUNIT_TEST(testBatch);
   CPPUNIT_TEST_SUITE_END();
 };
 
@@ -162,6 +1579,18 @@ int main()
   runner.addTest(VectorPositionTest::suite());
   runner.addTest(LineTest::suite());
   runner.addTest(ArcTest::suite());
+  runner.addTest(ContextTest::suite());
+  runner.addTest(PoolTest::suite());
+  runner.addTest(EllipsoidTest::suite());
+  runner.addTest(BatchTest::suite());
+  runner.addTest(LineIndexTest::suite());
+  runner.addTest(PositionIndexTest::suite());
+  runner.addTest(PolygonTest::suite());
+  runner.addTest(TrackTest::suite());
+  runner.addTest(FileTest::suite());
+  runner.addTest(CompactTest::suite());
+  runner.addTest(NVectorTest::suite());
+  runner.addTest(LocalProjectionTest::suite());
   if (runner.run()) 
     return 0; 
   else